@@ -54,7 +54,8 @@ _error_context_push(const char* name, size_t name_length, const char* data, size
 	error_context_t* context = get_thread_error_context();
 	if (!context) {
 		size_t capacity = sizeof(error_context_t) + (sizeof(error_frame_t) * foundation_config().error_context_depth);
-		context = memory_allocate(0, capacity, 0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		context = memory_allocate(0, capacity, 0,
+		                          MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED | MEMORY_NO_ARENA);
 		set_thread_error_context(context);
 	}
 	context->frame[ context->depth ].name.str = name ? name : "<something>";
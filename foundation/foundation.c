@@ -58,6 +58,7 @@ foundation_initialize_config(const foundation_config_t config) {
 	
 	_config.hash_store_size       = config.hash_store_size;
 	_config.random_state_prealloc = config.random_state_prealloc;
+	_config.job_thread_count      = config.job_thread_count;
 }
 
 #define SUBSYSTEM_INIT(system) if (ret == 0) ret = _##system##_initialize()
@@ -90,6 +91,7 @@ foundation_initialize(const memory_system_t memory, const application_t applicat
 	SUBSYSTEM_INIT_ARGS(environment, application);
 	SUBSYSTEM_INIT(library);
 	SUBSYSTEM_INIT(system);
+	SUBSYSTEM_INIT(job);
 
 	if (ret)
 		return ret;
@@ -138,6 +140,8 @@ foundation_finalize(void) {
 		return;
 	_initialized = false;
 
+	_job_finalize();
+
 	profile_finalize();
 
 	_fs_finalize();
@@ -30,6 +30,7 @@ Wrapper for foundation library headers and main entry/exit points */
 #include <foundation/mutex.h>
 #include <foundation/semaphore.h>
 #include <foundation/beacon.h>
+#include <foundation/job.h>
 #include <foundation/library.h>
 #include <foundation/system.h>
 #include <foundation/process.h>
@@ -41,6 +42,7 @@ Wrapper for foundation library headers and main entry/exit points */
 #include <foundation/hashstrings.h>
 #include <foundation/base64.h>
 #include <foundation/md5.h>
+#include <foundation/lz.h>
 #include <foundation/array.h>
 #include <foundation/bitbuffer.h>
 #include <foundation/hashmap.h>
@@ -82,7 +84,8 @@ Wrapper for foundation library headers and main entry/exit points */
 /*! Main entry point. Call this in your #main_initialize function to bootstrap the foundation
 library and initialize all functionality.
 \param memory       Memory system declaration (use memory_system_malloc for
-                    default system allocator)
+                    default system allocator, or memory_system_thread_cache for
+                    a thread caching allocator)
 \param application  Application declaration
 \param config       Application configuration
 \return             0 if initialization successful, <0 if error */
@@ -124,6 +124,12 @@ _exception_initialize(void);
 FOUNDATION_API void
 _exception_finalize(void);
 
+FOUNDATION_API int
+_job_initialize(void);
+
+FOUNDATION_API void
+_job_finalize(void);
+
 // Internal functions
 
 FOUNDATION_API uint32_t
@@ -0,0 +1,448 @@
+/* job.c  -  Foundation library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a cross-platform foundation library in C11 providing basic support
+ * data types and functions to write applications and games in a platform-independent fashion.
+ * The latest source code is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without
+ * any restrictions.
+ */
+
+#include <foundation/foundation.h>
+#include <foundation/internal.h>
+
+//Must be a power of two
+#define JOB_DEQUE_SIZE 4096
+#define JOB_DEQUE_MASK (JOB_DEQUE_SIZE - 1)
+
+//Marks the continuation list of a finished job, no more continuations can be added
+#define JOB_CONTINUATIONS_CLOSED ((void*)(uintptr_t)1)
+
+typedef struct job_link_t job_link_t;
+typedef struct job_parallel_t job_parallel_t;
+typedef struct job_deque_t job_deque_t;
+typedef struct job_worker_t job_worker_t;
+
+struct job_t {
+	job_fn fn;
+	void* arg;
+	const char* name;
+	size_t name_length;
+	//Unfinished dependencies, plus one until the job is submitted
+	atomic32_t pending;
+	//Caller reference plus scheduler reference until the job has finished
+	atomic32_t ref;
+	atomic32_t finished;
+	//List of job_link_t to jobs waiting for this job, or JOB_CONTINUATIONS_CLOSED
+	atomicptr_t continuations;
+	//Subrange of a parallel for job
+	job_parallel_t* parallel;
+	size_t begin;
+	size_t end;
+};
+
+struct job_link_t {
+	job_t* job;
+	job_link_t* next;
+};
+
+struct job_parallel_t {
+	job_range_fn fn;
+	void* arg;
+	size_t grain;
+	const char* name;
+	size_t name_length;
+	//Number of indices not yet processed
+	atomic64_t remaining;
+};
+
+//Chase-Lev work stealing deque. The owner pushes and pops at the bottom, other
+//threads steal from the top. Operations on the indices are sequentially consistent.
+struct FOUNDATION_ALIGN(64) job_deque_t {
+	atomic64_t top;
+	char pad_top[64 - sizeof(atomic64_t)];
+	atomic64_t bottom;
+	char pad_bottom[64 - sizeof(atomic64_t)];
+	atomicptr_t jobs[JOB_DEQUE_SIZE];
+};
+
+struct FOUNDATION_ALIGN(64) job_worker_t {
+	job_deque_t deque;
+	thread_t thread;
+};
+
+static job_worker_t* _job_workers;
+static size_t _job_worker_count;
+
+//Jobs submitted from threads which are not workers. Pushes are serialized by
+//the mutex, all threads take jobs by stealing.
+static job_deque_t* _job_injection;
+static mutex_t* _job_injection_lock;
+
+static semaphore_t _job_signal;
+static atomic32_t _job_sleeping;
+static atomic32_t _job_running;
+
+FOUNDATION_DECLARE_THREAD_LOCAL(int, job_worker, -1)
+
+static bool
+job_deque_push(job_deque_t* deque, job_t* job) {
+	int64_t bottom = atomic_load64(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load64(&deque->top, memory_order_acquire);
+	if (bottom - top >= JOB_DEQUE_SIZE)
+		return false;
+	atomic_store_ptr(&deque->jobs[bottom & JOB_DEQUE_MASK], job, memory_order_relaxed);
+	atomic_store64(&deque->bottom, bottom + 1, memory_order_release);
+	return true;
+}
+
+static job_t*
+job_deque_pop(job_deque_t* deque) {
+	//Locked decrement, the reservation must be visible before top is read
+	int64_t bottom = atomic_decr64(&deque->bottom, memory_order_seq_cst);
+	int64_t top = atomic_load64(&deque->top, memory_order_seq_cst);
+	if (top > bottom) {
+		atomic_store64(&deque->bottom, bottom + 1, memory_order_relaxed);
+		return nullptr;
+	}
+	job_t* job = atomic_load_ptr(&deque->jobs[bottom & JOB_DEQUE_MASK], memory_order_relaxed);
+	if (top == bottom) {
+		//Last job, race against thieves for it
+		if (!atomic_cas64(&deque->top, top + 1, top, memory_order_seq_cst, memory_order_relaxed))
+			job = nullptr;
+		atomic_store64(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+	return job;
+}
+
+static job_t*
+job_deque_steal(job_deque_t* deque) {
+	int64_t top = atomic_load64(&deque->top, memory_order_seq_cst);
+	int64_t bottom = atomic_load64(&deque->bottom, memory_order_seq_cst);
+	if (top >= bottom)
+		return nullptr;
+	job_t* job = atomic_load_ptr(&deque->jobs[top & JOB_DEQUE_MASK], memory_order_relaxed);
+	if (!atomic_cas64(&deque->top, top + 1, top, memory_order_seq_cst, memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+static void
+job_release(job_t* job) {
+	if (!atomic_decr32(&job->ref, memory_order_acq_rel))
+		memory_deallocate(job);
+}
+
+static void
+job_execute(job_t* job);
+
+//Idle workers announce themselves in the sleeping count before checking the queues a last
+//time, and schedulers check the count after publishing a job. The full fences on both sides
+//order the publishing store before the count load (and the count increment before the queue
+//loads), so either the scheduler sees the sleeper and posts, or the sleeper sees the job.
+//Posts to workers which then found a job anyway only cause a spurious wakeup.
+static void
+job_wake(void) {
+	atomic_thread_fence_sequentially_consistent();
+	if (atomic_load32(&_job_sleeping, memory_order_seq_cst) > 0)
+		semaphore_post(&_job_signal);
+}
+
+static void
+job_schedule(job_t* job) {
+	bool queued;
+	const int worker = get_thread_job_worker();
+	if (worker >= 0) {
+		queued = job_deque_push(&_job_workers[worker].deque, job);
+	}
+	else {
+		mutex_lock(_job_injection_lock);
+		queued = job_deque_push(_job_injection, job);
+		mutex_unlock(_job_injection_lock);
+	}
+
+	//Queues are full, the pool is saturated anyway
+	if (!queued)
+		job_execute(job);
+	else
+		job_wake();
+}
+
+static void
+job_finish(job_t* job) {
+	job_link_t* link;
+	do {
+		link = atomic_load_ptr(&job->continuations, memory_order_acquire);
+	}
+	while (!atomic_cas_ptr(&job->continuations, JOB_CONTINUATIONS_CLOSED, link,
+	                       memory_order_acq_rel, memory_order_acquire));
+
+	atomic_store32(&job->finished, 1, memory_order_release);
+
+	while (link) {
+		job_link_t* next = link->next;
+		if (!atomic_decr32(&link->job->pending, memory_order_acq_rel))
+			job_schedule(link->job);
+		memory_deallocate(link);
+		link = next;
+	}
+
+	job_release(job);
+}
+
+static void
+job_execute(job_t* job) {
+	//Jobs can run on any thread, so they never allocate from the arena of the thread
+	//which happens to execute them. Jobs executed while waiting inside another job
+	//already run without arena, nesting them must not grow the arena stack.
+	const bool has_arena = (memory_arena() != nullptr);
+	if (has_arena)
+		memory_arena_push(nullptr);
+	profile_begin_block(job->name, job->name_length);
+	job->fn(job->arg);
+	profile_end_block();
+	if (has_arena)
+		memory_arena_pop();
+	job_finish(job);
+}
+
+static job_t*
+job_find(void) {
+	const int worker = get_thread_job_worker();
+	job_t* job = (worker >= 0) ? job_deque_pop(&_job_workers[worker].deque) : nullptr;
+	if (!job)
+		job = job_deque_steal(_job_injection);
+	for (size_t iworker = 0; !job && (iworker < _job_worker_count); ++iworker) {
+		size_t victim = ((size_t)(worker + 1) + iworker) % _job_worker_count;
+		if ((int)victim != worker)
+			job = job_deque_steal(&_job_workers[victim].deque);
+	}
+	return job;
+}
+
+static bool
+job_help(void) {
+	job_t* job = job_find();
+	if (!job)
+		return false;
+	job_execute(job);
+	return true;
+}
+
+static void*
+job_worker(void* arg) {
+	set_thread_job_worker((int)(uintptr_t)arg);
+
+	while (atomic_load32(&_job_running, memory_order_acquire)) {
+		if (job_help())
+			continue;
+
+		atomic_incr32(&_job_sleeping, memory_order_seq_cst);
+		atomic_thread_fence_sequentially_consistent();
+		if (!job_help())
+			semaphore_wait(&_job_signal);
+		atomic_decr32(&_job_sleeping, memory_order_seq_cst);
+	}
+
+	return 0;
+}
+
+static job_t*
+job_allocate_range(job_parallel_t* parallel, size_t begin, size_t end);
+
+static void
+job_parallel_range(void* arg) {
+	job_t* job = arg;
+	job_parallel_t* parallel = job->parallel;
+	size_t begin = job->begin;
+	size_t end = job->end;
+
+	//Split off the upper half until within grain size, leaving the halves to be stolen
+	while (end - begin > parallel->grain) {
+		size_t mid = begin + ((end - begin) / 2);
+		job_t* split = job_allocate_range(parallel, mid, end);
+		job_submit(split);
+		job_deallocate(split);
+		end = mid;
+	}
+
+	parallel->fn(begin, end, parallel->arg);
+	atomic_add64(&parallel->remaining, -(int64_t)(end - begin), memory_order_release);
+}
+
+static job_t*
+job_allocate_range(job_parallel_t* parallel, size_t begin, size_t end) {
+	job_t* job = job_allocate(parallel->name, parallel->name_length, job_parallel_range, nullptr);
+	job->arg = job;
+	job->parallel = parallel;
+	job->begin = begin;
+	job->end = end;
+	return job;
+}
+
+job_t*
+job_allocate(const char* name, size_t length, job_fn fn, void* arg) {
+	job_t* job = memory_allocate(0, sizeof(job_t), 0,
+	                             MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED | MEMORY_NO_ARENA);
+	job->fn = fn;
+	job->arg = arg;
+	job->name = name;
+	job->name_length = length;
+	atomic_store32(&job->pending, 1, memory_order_relaxed);
+	atomic_store32(&job->ref, 2, memory_order_relaxed);
+	atomic_store32(&job->finished, 0, memory_order_relaxed);
+	atomic_store_ptr(&job->continuations, nullptr, memory_order_release);
+	return job;
+}
+
+void
+job_deallocate(job_t* job) {
+	if (job)
+		job_release(job);
+}
+
+void
+job_add_dependency(job_t* job, job_t* dependency) {
+	job_link_t* link = memory_allocate(0, sizeof(job_link_t), 0, MEMORY_PERSISTENT | MEMORY_NO_ARENA);
+	link->job = job;
+
+	atomic_incr32(&job->pending, memory_order_acq_rel);
+	while (true) {
+		job_link_t* head = atomic_load_ptr(&dependency->continuations, memory_order_acquire);
+		if (head == JOB_CONTINUATIONS_CLOSED) {
+			//Dependency already finished
+			atomic_decr32(&job->pending, memory_order_acq_rel);
+			memory_deallocate(link);
+			return;
+		}
+		link->next = head;
+		if (atomic_cas_ptr(&dependency->continuations, link, head,
+		                   memory_order_acq_rel, memory_order_acquire))
+			return;
+	}
+}
+
+void
+job_add_continuation(job_t* job, job_t* continuation) {
+	job_add_dependency(continuation, job);
+	job_submit(continuation);
+}
+
+void
+job_submit(job_t* job) {
+	if (!atomic_decr32(&job->pending, memory_order_acq_rel))
+		job_schedule(job);
+}
+
+void
+job_wait(job_t* job) {
+	while (!job_is_finished(job)) {
+		if (!job_help())
+			thread_yield();
+	}
+}
+
+bool
+job_is_finished(const job_t* job) {
+	return atomic_load32(&job->finished, memory_order_acquire) != 0;
+}
+
+void
+job_parallel_for(const char* name, size_t length, size_t count, size_t grain,
+                 job_range_fn fn, void* arg) {
+	if (!grain)
+		grain = 1;
+	if (count <= grain) {
+		if (count) {
+			const bool has_arena = (memory_arena() != nullptr);
+			if (has_arena)
+				memory_arena_push(nullptr);
+			profile_begin_block(name, length);
+			fn(0, count, arg);
+			profile_end_block();
+			if (has_arena)
+				memory_arena_pop();
+		}
+		return;
+	}
+
+	job_parallel_t parallel;
+	parallel.fn = fn;
+	parallel.arg = arg;
+	parallel.grain = grain;
+	parallel.name = name;
+	parallel.name_length = length;
+	atomic_store64(&parallel.remaining, (int64_t)count, memory_order_release);
+
+	job_t* root = job_allocate_range(&parallel, 0, count);
+	job_submit(root);
+	job_deallocate(root);
+
+	//Subrange jobs do not touch the parallel block after accounting for their indices,
+	//so it can safely go out of scope once all indices are done
+	while (atomic_load64(&parallel.remaining, memory_order_acquire) > 0) {
+		if (!job_help())
+			thread_yield();
+	}
+}
+
+size_t
+job_thread_count(void) {
+	return _job_worker_count;
+}
+
+int
+_job_initialize(void) {
+	size_t count = foundation_config().job_thread_count;
+	if (!count) {
+		count = system_hardware_threads();
+		count = (count > 1) ? count - 1 : 1;
+	}
+
+	atomic_store32(&_job_sleeping, 0, memory_order_relaxed);
+	atomic_store32(&_job_running, 1, memory_order_release);
+	semaphore_initialize(&_job_signal, 0);
+
+	_job_injection = memory_allocate(0, sizeof(job_deque_t), 64,
+	                                 MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	_job_injection_lock = mutex_allocate(STRING_CONST("job_injection"));
+
+	_job_workers = memory_allocate(0, sizeof(job_worker_t) * count, 64,
+	                               MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+	_job_worker_count = count;
+	for (size_t iworker = 0; iworker < count; ++iworker) {
+		job_worker_t* worker = _job_workers + iworker;
+		thread_initialize(&worker->thread, job_worker, (void*)(uintptr_t)iworker,
+		                  STRING_CONST("job_worker"), THREAD_PRIORITY_NORMAL, 0);
+		thread_start(&worker->thread);
+	}
+
+	return 0;
+}
+
+void
+_job_finalize(void) {
+	if (!_job_workers)
+		return;
+
+	atomic_store32(&_job_running, 0, memory_order_release);
+	for (size_t iworker = 0; iworker < _job_worker_count; ++iworker)
+		semaphore_post(&_job_signal);
+	for (size_t iworker = 0; iworker < _job_worker_count; ++iworker) {
+		thread_join(&_job_workers[iworker].thread);
+		thread_finalize(&_job_workers[iworker].thread);
+	}
+
+	memory_deallocate(_job_workers);
+	_job_workers = nullptr;
+	_job_worker_count = 0;
+
+	mutex_deallocate(_job_injection_lock);
+	memory_deallocate(_job_injection);
+	_job_injection_lock = nullptr;
+	_job_injection = nullptr;
+
+	semaphore_finalize(&_job_signal);
+}
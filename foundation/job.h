@@ -0,0 +1,96 @@
+/* job.h  -  Foundation library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a cross-platform foundation library in C11 providing basic support
+ * data types and functions to write applications and games in a platform-independent fashion.
+ * The latest source code is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without
+ * any restrictions.
+ */
+
+#pragma once
+
+/*! \file job.h
+\brief Work stealing job scheduler
+
+Jobs are small units of work executed by a fixed pool of worker threads, sized to the
+hardware. Each worker owns a deque of jobs, pushing and popping at one end, while idle
+workers steal from the other end of the deques of other workers. Jobs submitted from
+threads which are not workers are queued on a shared injection queue.
+
+A job can depend on other jobs, in which case it is not executed until all dependencies
+have finished. Threads waiting for a job to finish execute other pending jobs meanwhile,
+which makes it safe to wait for jobs from inside a job.
+
+Each executed job is wrapped in a profile block named after the job, so job names must be
+constant strings which outlive the job. Blocking operations (process execution, file or
+network I/O) should use dedicated threads rather than jobs, as they would starve the pool. */
+
+#include <foundation/platform.h>
+#include <foundation/types.h>
+
+/*! Allocate a new job. The job is not scheduled until #job_submit is called, which allows
+dependencies to be added first.
+\param name Job name used for profiling, must be a constant string outliving the job
+\param length Length of name
+\param fn Job function
+\param arg Argument passed to the job function
+\return New job */
+FOUNDATION_API job_t*
+job_allocate(const char* name, size_t length, job_fn fn, void* arg);
+
+/*! Release the caller reference of a job. The job memory is released once the job has also
+finished executing, so a submitted job can be released right away if it is never waited on.
+\param job Job */
+FOUNDATION_API void
+job_deallocate(job_t* job);
+
+/*! Make a job wait for another job to finish before executing. Must be called before the job
+is submitted. Adding a dependency on a job which has already finished has no effect.
+\param job Job which will wait for the dependency
+\param dependency Job to wait for */
+FOUNDATION_API void
+job_add_dependency(job_t* job, job_t* dependency);
+
+/*! Schedule a job as a continuation of another job, i.e. submit it to be executed as soon
+as the given job has finished. The continuation must not have been submitted already.
+\param job Job to continue
+\param continuation Job to execute once job has finished */
+FOUNDATION_API void
+job_add_continuation(job_t* job, job_t* continuation);
+
+/*! Submit a job for execution. The job is queued once all its dependencies have finished.
+\param job Job */
+FOUNDATION_API void
+job_submit(job_t* job);
+
+/*! Wait for a submitted job to finish, executing other pending jobs while waiting.
+\param job Job */
+FOUNDATION_API void
+job_wait(job_t* job);
+
+/*! Query if a job has finished executing
+\param job Job
+\return true if job has finished, false if not */
+FOUNDATION_API bool
+job_is_finished(const job_t* job);
+
+/*! Execute a function over the index range [0, count) in parallel and wait for all indices
+to be processed. The range is split recursively into subranges of at most grain indices,
+which are distributed over the worker threads. The calling thread participates.
+\param name Name used for profiling the subrange jobs, must be a constant string
+\param length Length of name
+\param count Number of indices
+\param grain Maximum number of indices processed by a single call to fn, zero for one
+\param fn Function called for each subrange
+\param arg Argument passed to fn */
+FOUNDATION_API void
+job_parallel_for(const char* name, size_t length, size_t count, size_t grain,
+                 job_range_fn fn, void* arg);
+
+/*! Get number of job worker threads
+\return Number of worker threads */
+FOUNDATION_API size_t
+job_thread_count(void);
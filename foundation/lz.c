@@ -0,0 +1,305 @@
+/* lz.c  -  Foundation library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a cross-platform foundation library in C11 providing basic support
+ * data types and functions to write applications and games in a platform-independent fashion.
+ * The latest source code is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without
+ * any restrictions.
+ */
+
+#include <foundation/foundation.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+//Matches end that far from the end of input, so that sequences always read four whole bytes
+#define LZ_END_LITERALS 5
+//Positions skipped between match attempts grow with consecutive misses, speeding up on
+//incompressible data
+#define LZ_SKIP_TRIGGER 6
+#define LZ_STORED_BLOCK 0x80000000U
+#define LZ_BLOCK_HEADER_SIZE 8
+
+static FOUNDATION_FORCEINLINE uint32_t
+lz_read32(const uint8_t* p) {
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static FOUNDATION_FORCEINLINE uint32_t
+lz_hash(uint32_t value) {
+	return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t*
+lz_write_length(uint8_t* op, const uint8_t* oend, size_t length) {
+	while (length >= 255) {
+		if (op >= oend)
+			return nullptr;
+		*op++ = 255;
+		length -= 255;
+	}
+	if (op >= oend)
+		return nullptr;
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+static bool
+lz_read_length(const uint8_t** ip, const uint8_t* iend, size_t* length) {
+	uint8_t value;
+	do {
+		if (*ip >= iend)
+			return false;
+		value = *(*ip)++;
+		*length += value;
+	} while (value == 255);
+	return true;
+}
+
+//Writes a sequence of literals followed by a back reference, unless last is set in which
+//case the sequence only holds literals
+static uint8_t*
+lz_write_sequence(uint8_t* op, const uint8_t* oend, const uint8_t* literals, size_t literal_length,
+                  size_t offset, size_t match_length, bool last) {
+	if (op >= oend)
+		return nullptr;
+	uint8_t* token = op++;
+	*token = (uint8_t)(((literal_length < 15) ? literal_length : 15) << 4);
+	if (literal_length >= 15) {
+		op = lz_write_length(op, oend, literal_length - 15);
+		if (!op)
+			return nullptr;
+	}
+	if (literal_length > (size_t)(oend - op))
+		return nullptr;
+	memcpy(op, literals, literal_length);
+	op += literal_length;
+	if (last)
+		return op;
+
+	if ((size_t)(oend - op) < 2)
+		return nullptr;
+	*op++ = (uint8_t)(offset & 0xFF);
+	*op++ = (uint8_t)(offset >> 8);
+	*token |= (uint8_t)((match_length < 15) ? match_length : 15);
+	if (match_length >= 15)
+		op = lz_write_length(op, oend, match_length - 15);
+	return op;
+}
+
+size_t
+lz_compress_bound(size_t size) {
+	return size + (size / 255) + 16;
+}
+
+size_t
+lz_compress(const void* source, size_t size, void* destination, size_t capacity) {
+	uint32_t table[1 << LZ_HASH_BITS];
+	const uint8_t* base = source;
+	const uint8_t* end = base + size;
+	const uint8_t* match_limit = (size > LZ_END_LITERALS + LZ_MIN_MATCH) ? end - LZ_END_LITERALS : base;
+	const uint8_t* ip = base;
+	const uint8_t* anchor = base;
+	uint8_t* op = destination;
+	const uint8_t* oend = op + capacity;
+	unsigned int misses = 0;
+
+	FOUNDATION_ASSERT_MSG(size <= 0xFFFFFFFFU, "Block too large, positions are stored as 32-bit");
+	memset(table, 0, sizeof(table));
+
+	while (ip + LZ_MIN_MATCH <= match_limit) {
+		const uint32_t sequence = lz_read32(ip);
+		const uint32_t hash = lz_hash(sequence);
+		const uint8_t* ref = base + table[hash];
+		table[hash] = (uint32_t)(ip - base);
+
+		if ((ref >= ip) || ((size_t)(ip - ref) > LZ_MAX_OFFSET) || (lz_read32(ref) != sequence)) {
+			ip += 1 + (misses++ >> LZ_SKIP_TRIGGER);
+			continue;
+		}
+
+		while ((ip > anchor) && (ref > base) && (ip[-1] == ref[-1])) {
+			--ip;
+			--ref;
+		}
+
+		const uint8_t* match_end = ip + LZ_MIN_MATCH;
+		const uint8_t* ref_end = ref + LZ_MIN_MATCH;
+		while ((match_end < match_limit) && (*match_end == *ref_end)) {
+			++match_end;
+			++ref_end;
+		}
+
+		op = lz_write_sequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref),
+		                       (size_t)(match_end - ip) - LZ_MIN_MATCH, false);
+		if (!op)
+			return 0;
+
+		ip = match_end;
+		anchor = ip;
+		misses = 0;
+
+		//Positions inside the match are skipped, keep the one right before the next search
+		table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+	}
+
+	op = lz_write_sequence(op, oend, anchor, (size_t)(end - anchor), 0, 0, true);
+	if (!op)
+		return 0;
+	return (size_t)(op - (uint8_t*)destination);
+}
+
+size_t
+lz_decompress(const void* source, size_t size, void* destination, size_t capacity) {
+	const uint8_t* ip = source;
+	const uint8_t* iend = ip + size;
+	uint8_t* base = destination;
+	uint8_t* op = base;
+	const uint8_t* oend = base + capacity;
+
+	while (ip < iend) {
+		const uint8_t token = *ip++;
+
+		size_t length = token >> 4;
+		if ((length == 15) && !lz_read_length(&ip, iend, &length))
+			return 0;
+		if ((length > (size_t)(iend - ip)) || (length > (size_t)(oend - op)))
+			return 0;
+		memcpy(op, ip, length);
+		ip += length;
+		op += length;
+
+		//Last sequence only holds literals
+		if (ip == iend)
+			break;
+
+		if ((size_t)(iend - ip) < 2)
+			return 0;
+		const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (!offset || (offset > (size_t)(op - base)))
+			return 0;
+
+		length = token & 0xF;
+		if ((length == 15) && !lz_read_length(&ip, iend, &length))
+			return 0;
+		length += LZ_MIN_MATCH;
+		if (length > (size_t)(oend - op))
+			return 0;
+
+		const uint8_t* ref = op - offset;
+		if (offset >= length) {
+			memcpy(op, ref, length);
+			op += length;
+		}
+		else {
+			//Overlapping copy repeating the last offset bytes
+			for (size_t i = 0; i < length; ++i)
+				*op++ = *ref++;
+		}
+	}
+
+	return (size_t)(op - base);
+}
+
+static void
+lz_write_block_header(uint8_t* header, uint32_t size, uint32_t stored_size) {
+	for (unsigned int i = 0; i < 4; ++i) {
+		header[i] = (uint8_t)(size >> (i * 8));
+		header[i + 4] = (uint8_t)(stored_size >> (i * 8));
+	}
+}
+
+static void
+lz_read_block_header(const uint8_t* header, uint32_t* size, uint32_t* stored_size) {
+	*size = 0;
+	*stored_size = 0;
+	for (unsigned int i = 0; i < 4; ++i) {
+		*size |= (uint32_t)header[i] << (i * 8);
+		*stored_size |= (uint32_t)header[i + 4] << (i * 8);
+	}
+}
+
+size_t
+lz_compress_stream(stream_t* source, stream_t* destination) {
+	const size_t capacity = lz_compress_bound(LZ_BLOCK_SIZE);
+	uint8_t* buffer = memory_allocate(0, LZ_BLOCK_SIZE + LZ_BLOCK_HEADER_SIZE + capacity, 0,
+	                                  MEMORY_TEMPORARY);
+	uint8_t* block = buffer + LZ_BLOCK_SIZE;
+	size_t written = 0;
+
+	while (!stream_eos(source)) {
+		const size_t read = stream_read(source, buffer, LZ_BLOCK_SIZE);
+		if (!read)
+			break;
+
+		//Blocks which would not get smaller are stored as is
+		size_t stored_size = lz_compress(buffer, read, block + LZ_BLOCK_HEADER_SIZE, read - 1);
+		if (!stored_size) {
+			memcpy(block + LZ_BLOCK_HEADER_SIZE, buffer, read);
+			lz_write_block_header(block, (uint32_t)read, (uint32_t)read | LZ_STORED_BLOCK);
+			stored_size = read;
+		}
+		else {
+			lz_write_block_header(block, (uint32_t)read, (uint32_t)stored_size);
+		}
+		written += stream_write(destination, block, LZ_BLOCK_HEADER_SIZE + stored_size);
+	}
+
+	lz_write_block_header(block, 0, 0);
+	written += stream_write(destination, block, LZ_BLOCK_HEADER_SIZE);
+
+	memory_deallocate(buffer);
+	return written;
+}
+
+size_t
+lz_decompress_stream(stream_t* source, stream_t* destination) {
+	uint8_t* buffer = memory_allocate(0, LZ_BLOCK_SIZE * 2, 0, MEMORY_TEMPORARY);
+	uint8_t* block = buffer + LZ_BLOCK_SIZE;
+	uint8_t header[LZ_BLOCK_HEADER_SIZE];
+	size_t written = 0;
+
+	while (true) {
+		if (stream_read(source, header, sizeof(header)) != sizeof(header)) {
+			log_error(HASH_STREAM, ERROR_INVALID_VALUE, STRING_CONST("Truncated compressed stream"));
+			break;
+		}
+
+		uint32_t size, stored_size;
+		lz_read_block_header(header, &size, &stored_size);
+		if (!size)
+			break;
+
+		const bool stored = (stored_size & LZ_STORED_BLOCK) != 0;
+		stored_size &= ~LZ_STORED_BLOCK;
+		if ((size > LZ_BLOCK_SIZE) || (stored_size > LZ_BLOCK_SIZE) || (stored && (stored_size != size))) {
+			log_error(HASH_STREAM, ERROR_INVALID_VALUE, STRING_CONST("Invalid compressed stream block"));
+			break;
+		}
+
+		if (stream_read(source, block, stored_size) != stored_size) {
+			log_error(HASH_STREAM, ERROR_INVALID_VALUE, STRING_CONST("Truncated compressed stream"));
+			break;
+		}
+
+		if (stored) {
+			written += stream_write(destination, block, size);
+		}
+		else {
+			if (lz_decompress(block, stored_size, buffer, LZ_BLOCK_SIZE) != size) {
+				log_error(HASH_STREAM, ERROR_INVALID_VALUE, STRING_CONST("Invalid compressed stream block"));
+				break;
+			}
+			written += stream_write(destination, buffer, size);
+		}
+	}
+
+	memory_deallocate(buffer);
+	return written;
+}
@@ -0,0 +1,76 @@
+/* lz.h  -  Foundation library  -  Public Domain  -  2013 Mattias Jansson / Rampant Pixels
+ *
+ * This library provides a cross-platform foundation library in C11 providing basic support
+ * data types and functions to write applications and games in a platform-independent fashion.
+ * The latest source code is always available at
+ *
+ * https://github.com/rampantpixels/foundation_lib
+ *
+ * This library is put in the public domain; you can redistribute it and/or modify it without
+ * any restrictions.
+ */
+
+#pragma once
+
+/*! \file lz.h
+\brief LZ block compression
+
+Fast LZ77 family block codec, trading compression ratio for speed. Compressed data is a
+sequence of literal runs and back references of at least four bytes into the previous 64KiB
+of output, each sequence starting with a token byte holding both lengths (in the manner of
+LZ4). Decompression does not allocate any memory and checks all bounds, so corrupted data
+makes it fail rather than overrun buffers.
+
+Raw buffers are compressed as a single block. Streams are compressed as a sequence of blocks
+of at most #LZ_BLOCK_SIZE bytes, each prefixed by its decompressed and compressed sizes, and
+terminated by an empty block. Blocks which do not compress are stored as is. */
+
+#include <foundation/platform.h>
+#include <foundation/types.h>
+
+/*! Maximum number of decompressed bytes held by a single block of a compressed stream */
+#define LZ_BLOCK_SIZE (64 * 1024)
+
+/*! Get the size of a destination buffer large enough to compress a buffer of the given size
+whatever its content
+\param size Size of source data in bytes
+\return     Worst case compressed size in bytes */
+FOUNDATION_API size_t
+lz_compress_bound(size_t size);
+
+/*! Compress a buffer as a single block. Source and destination buffers must not overlap.
+\param source      Source data buffer
+\param size        Size of source data in bytes
+\param destination Destination buffer
+\param capacity    Capacity of destination buffer in bytes
+\return            Number of bytes written to destination buffer, 0 if the compressed data
+                   does not fit in the destination buffer */
+FOUNDATION_API size_t
+lz_compress(const void* source, size_t size, void* destination, size_t capacity);
+
+/*! Decompress a block compressed by #lz_compress. Source and destination buffers must not
+overlap.
+\param source      Compressed data buffer
+\param size        Size of compressed data in bytes
+\param destination Destination buffer
+\param capacity    Capacity of destination buffer in bytes
+\return            Number of bytes written to destination buffer, 0 if the compressed data is
+                   invalid or does not fit in the destination buffer */
+FOUNDATION_API size_t
+lz_decompress(const void* source, size_t size, void* destination, size_t capacity);
+
+/*! Compress the remaining data of a stream into another stream, as a sequence of blocks
+\param source      Source stream, read until end of stream
+\param destination Destination stream
+\return            Number of bytes written to destination stream */
+FOUNDATION_API size_t
+lz_compress_stream(stream_t* source, stream_t* destination);
+
+/*! Decompress a sequence of blocks written by #lz_compress_stream into another stream, up to
+and including its terminating empty block
+\param source      Source stream
+\param destination Destination stream
+\return            Number of bytes written to destination stream. Fails (logging an error)
+                   at the first invalid block, anything before it being written */
+FOUNDATION_API size_t
+lz_decompress_stream(stream_t* source, stream_t* destination);
@@ -51,6 +51,8 @@ typedef FOUNDATION_ALIGN(8) struct {
 	atomic32_t allocations_current;
 	atomic32_t allocated_total;
 	atomic32_t allocated_current;
+	atomic32_t arenas_current;
+	atomic32_t arena_allocated_current;
 } memory_statistics_atomic_t;
 
 FOUNDATION_STATIC_ASSERT(sizeof(memory_statistics_t) == sizeof(memory_statistics_atomic_t),
@@ -68,18 +70,89 @@ static memory_tracker_t _memory_tracker;
 static memory_tracker_t _memory_tracker_preinit;
 
 static void
-_memory_track(void* addr, size_t size);
+_memory_track(void* addr, size_t size, hash_t context);
 
-static void
+static hash_t
 _memory_untrack(void* addr);
 
 #else
 
-#define _memory_track(addr, size ) do { (void)sizeof( (addr) ); (void)sizeof( (size) ); } while(0)
-#define _memory_untrack(addr) do { (void)sizeof( (addr) ); } while(0)
+#define _memory_track(addr, size, context) do { (void)sizeof( (addr) ); (void)sizeof( (size) ); (void)sizeof( (context) ); } while(0)
+static FOUNDATION_FORCEINLINE hash_t
+_memory_untrack(void* addr) {
+	FOUNDATION_UNUSED(addr);
+	return 0;
+}
+
+#endif
+
+#define MEMORY_ARENA_STACK_DEPTH 8
+#define MEMORY_ARENA_BLOCK_SIZE (64 * 1024)
+#define MEMORY_ARENA_BLOCK_GROWTH_LIMIT (16 * 1024 * 1024)
+#define MEMORY_SCRATCH_BLOCK_SIZE (256 * 1024)
+#define MEMORY_ARENA_TAG ((uintptr_t)0xA7E4A7A6ULL)
+
+typedef struct memory_arena_block_t memory_arena_block_t;
+
+FOUNDATION_ALIGNED_STRUCT(memory_arena_block_t, 16) {
+	memory_arena_block_t* next;
+	size_t size;
+	size_t used;
+};
+
+struct memory_arena_t {
+	hash_t context;
+	size_t block_size;
+	size_t reserved;
+	//Most recent block first, allocations are made from the head block only
+	memory_arena_block_t* block;
+	//Last allocation, which can be grown in place
+	void* last;
+};
+
+//Header in front of each arena allocation, telling arena memory apart from memory system
+//blocks without searching the arena blocks. Memory systems always keep the bytes in front
+//of a block readable (heap chunk headers, alignment padding or guards), none of which can
+//hold the tag.
+typedef struct memory_arena_header_t memory_arena_header_t;
+
+struct memory_arena_header_t {
+	memory_arena_t* arena;
+	uintptr_t tag;
+};
+
+#define MEMORY_ARENA_HEADER_SIZE FOUNDATION_MIN_ALIGN
 
+FOUNDATION_STATIC_ASSERT(sizeof(memory_arena_header_t) <= MEMORY_ARENA_HEADER_SIZE,
+                         "Arena header does not fit in minimum alignment");
+
+FOUNDATION_DECLARE_THREAD_LOCAL_ARRAY(memory_arena_t*, memory_arena_stack, MEMORY_ARENA_STACK_DEPTH)
+FOUNDATION_DECLARE_THREAD_LOCAL(size_t, memory_arena_depth, 0)
+FOUNDATION_DECLARE_THREAD_LOCAL(memory_arena_t*, memory_scratch, 0)
+
+#if BUILD_ENABLE_MEMORY_STATISTICS
+FOUNDATION_DECLARE_THREAD_LOCAL(size_t, memory_allocations, 0)
+#define _memory_count_allocation() set_thread_memory_allocations(get_thread_memory_allocations() + 1)
+#else
+#define _memory_count_allocation() do { } while(0)
 #endif
 
+static memory_arena_t*
+_memory_arena_active(void);
+
+static memory_arena_t*
+_memory_arena_of(const void* p);
+
+static void*
+_memory_arena_allocate(memory_arena_t* arena, size_t size, unsigned int align, unsigned int hint);
+
+static void*
+_memory_arena_reallocate(memory_arena_t* arena, void* p, size_t size, unsigned int align,
+                         size_t oldsize, unsigned int hint);
+
+static void
+_memory_scratch_finalize(void);
+
 int
 _memory_initialize(const memory_system_t memory) {
 	int ret;
@@ -99,6 +172,7 @@ _memory_initialize(const memory_system_t memory) {
 
 void
 _memory_finalize(void) {
+	_memory_scratch_finalize();
 #if BUILD_ENABLE_MEMORY_TRACKER
 	_memory_tracker_preinit = _memory_tracker;
 	if (_memory_tracker.finalize)
@@ -148,21 +222,44 @@ _memory_guard_verify(void* memory) {
 
 void*
 memory_allocate(hash_t context, size_t size, unsigned int align, unsigned int hint) {
-	void* p = _memory_system.allocate(context ? context : memory_context(), size, align, hint);
-	_memory_track(p, size);
+	memory_arena_t* arena = _memory_arena_active();
+	if (arena && !(hint & MEMORY_NO_ARENA))
+		return _memory_arena_allocate(arena, size, align, hint);
+	_memory_count_allocation();
+	if (!context)
+		context = memory_context();
+	void* p = _memory_system.allocate(context, size, align, hint);
+	_memory_track(p, size, context);
 	return p;
 }
 
 void*
 memory_reallocate(void* p, size_t size, unsigned int align, size_t oldsize, unsigned int hint) {
-	_memory_untrack(p);
+	//Memory allocated outside the arena scope stays with the memory system
+	memory_arena_t* arena = p ? _memory_arena_of(p) : _memory_arena_active();
+	if (arena && p && (hint & MEMORY_NO_ARENA)) {
+		//Moving arena memory out to the memory system, the arena keeps the old block
+		void* memory = memory_allocate(0, size, align, hint & ~MEMORY_ZERO_INITIALIZED);
+		if (memory && oldsize && !(hint & MEMORY_NO_PRESERVE))
+			memcpy(memory, p, (size < oldsize) ? size : oldsize);
+		return memory;
+	}
+	if (arena && !(hint & MEMORY_NO_ARENA))
+		return _memory_arena_reallocate(arena, p, size, align, oldsize, hint);
+	_memory_count_allocation();
+	//Keep the block in the context it was allocated in rather than the current one
+	hash_t context = _memory_untrack(p);
+	if (!context)
+		context = memory_context();
 	p = _memory_system.reallocate(p, size, align, oldsize, hint);
-	_memory_track(p, size);
+	_memory_track(p, size, context);
 	return p;
 }
 
 void
 memory_deallocate(void* p) {
+	if (p && _memory_arena_of(p))
+		return;
 	_memory_untrack(p);
 	_memory_system.deallocate(p);
 }
@@ -175,6 +272,270 @@ memory_statistics(void) {
 	return stats;
 }
 
+memory_statistics_t
+memory_context_statistics(hash_t context) {
+	memory_statistics_t stats;
+#if BUILD_ENABLE_MEMORY_TRACKER
+	if (_memory_tracker.context_statistics)
+		return _memory_tracker.context_statistics(context);
+#else
+	FOUNDATION_UNUSED(context);
+#endif
+	memset(&stats, 0, sizeof(stats));
+	return stats;
+}
+
+static memory_arena_t*
+_memory_arena_active(void) {
+	size_t depth = get_thread_memory_arena_depth();
+	return depth ? get_thread_memory_arena_stack()[depth - 1] : nullptr;
+}
+
+static memory_arena_t*
+_memory_arena_of(const void* p) {
+	const memory_arena_header_t* header = pointer_offset_const(p, -MEMORY_ARENA_HEADER_SIZE);
+	if (header->tag != MEMORY_ARENA_TAG)
+		return nullptr;
+#if BUILD_ENABLE_ASSERT
+	//Arena memory is only handed back while its arena is active (or is the thread scratch
+	//arena), anything else is a use after the arena was released or a block gone astray
+	bool in_scope = (header->arena == get_thread_memory_scratch());
+	for (size_t iarena = 0; !in_scope && (iarena < get_thread_memory_arena_depth()); ++iarena)
+		in_scope = (get_thread_memory_arena_stack()[iarena] == header->arena);
+	FOUNDATION_ASSERT_MSG(in_scope, "Arena memory handed back outside of its arena scope");
+#endif
+	return header->arena;
+}
+
+static void*
+_memory_arena_block_data(memory_arena_block_t* block) {
+	return pointer_offset(block, sizeof(memory_arena_block_t));
+}
+
+static memory_arena_block_t*
+_memory_arena_block_allocate(memory_arena_t* arena, size_t size) {
+	size_t total = sizeof(memory_arena_block_t) + size;
+	_memory_count_allocation();
+	memory_arena_block_t* block = _memory_system.allocate(arena->context, total, 16, MEMORY_PERSISTENT);
+	if (!block)
+		return nullptr;
+	_memory_track(block, total, arena->context);
+
+	block->next = arena->block;
+	block->size = size;
+	block->used = 0;
+	arena->block = block;
+	arena->reserved += size;
+
+#if BUILD_ENABLE_MEMORY_STATISTICS
+	atomic_add32(&_memory_stats.arena_allocated_current, (int32_t)total, memory_order_relaxed);
+	atomic_thread_fence_release();
+#endif
+	return block;
+}
+
+static void
+_memory_arena_block_deallocate(memory_arena_t* arena, memory_arena_block_t* block) {
+	arena->reserved -= block->size;
+#if BUILD_ENABLE_MEMORY_STATISTICS
+	atomic_add32(&_memory_stats.arena_allocated_current,
+	             -(int32_t)(sizeof(memory_arena_block_t) + block->size), memory_order_relaxed);
+	atomic_thread_fence_release();
+#endif
+	_memory_untrack(block);
+	_memory_system.deallocate(block);
+}
+
+static void*
+_memory_arena_allocate(memory_arena_t* arena, size_t size, unsigned int align, unsigned int hint) {
+	if (align < FOUNDATION_MIN_ALIGN)
+		align = FOUNDATION_MIN_ALIGN;
+
+	memory_arena_block_t* block = arena->block;
+	uintptr_t base = 0;
+	uintptr_t start = 0;
+	if (block) {
+		base = (uintptr_t)_memory_arena_block_data(block);
+		start = (base + block->used + MEMORY_ARENA_HEADER_SIZE + (align - 1)) & ~(uintptr_t)(align - 1);
+	}
+
+	if (!block || (start + size > base + block->size)) {
+		//Grow blocks along with the arena, so the number of blocks stays low
+		size_t block_size = arena->reserved;
+		if (block_size > MEMORY_ARENA_BLOCK_GROWTH_LIMIT)
+			block_size = MEMORY_ARENA_BLOCK_GROWTH_LIMIT;
+		if (block_size < arena->block_size)
+			block_size = arena->block_size;
+		if (block_size < size + align + MEMORY_ARENA_HEADER_SIZE)
+			block_size = size + align + MEMORY_ARENA_HEADER_SIZE;
+
+		block = _memory_arena_block_allocate(arena, block_size);
+		if (!block) {
+			log_errorf(HASH_MEMORY, ERROR_OUT_OF_MEMORY,
+			           STRING_CONST("Unable to allocate %" PRIsize " bytes of arena memory"), size);
+			return nullptr;
+		}
+		base = (uintptr_t)_memory_arena_block_data(block);
+		start = (base + MEMORY_ARENA_HEADER_SIZE + (align - 1)) & ~(uintptr_t)(align - 1);
+	}
+
+	memory_arena_header_t* header = (memory_arena_header_t*)(start - MEMORY_ARENA_HEADER_SIZE);
+	header->arena = arena;
+	header->tag = MEMORY_ARENA_TAG;
+
+	block->used = (size_t)(start - base) + size;
+	arena->last = (void*)start;
+	if (hint & MEMORY_ZERO_INITIALIZED)
+		memset(arena->last, 0, size);
+	return arena->last;
+}
+
+static void*
+_memory_arena_reallocate(memory_arena_t* arena, void* p, size_t size, unsigned int align,
+                         size_t oldsize, unsigned int hint) {
+	memory_arena_block_t* block = arena->block;
+	if (p && (p == arena->last) && !((uintptr_t)p & (uintptr_t)(align ? align - 1 : 0))) {
+		//Last allocation of the head block, grow or shrink in place if it fits
+		uintptr_t base = (uintptr_t)_memory_arena_block_data(block);
+		if ((uintptr_t)p + size <= base + block->size) {
+			block->used = (size_t)((uintptr_t)p - base) + size;
+			return p;
+		}
+	}
+
+	void* memory = _memory_arena_allocate(arena, size, align, hint & ~MEMORY_ZERO_INITIALIZED);
+	if (p && memory && oldsize && !(hint & MEMORY_NO_PRESERVE))
+		memcpy(memory, p, (size < oldsize) ? size : oldsize);
+	return memory;
+}
+
+memory_arena_t*
+memory_arena_allocate(hash_t context, size_t block_size) {
+	memory_arena_t* arena = memory_allocate(context, sizeof(memory_arena_t), 0,
+	                                        MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED | MEMORY_NO_ARENA);
+	arena->context = context ? context : memory_context();
+	arena->block_size = block_size ? block_size : MEMORY_ARENA_BLOCK_SIZE;
+#if BUILD_ENABLE_MEMORY_STATISTICS
+	atomic_incr32(&_memory_stats.arenas_current, memory_order_relaxed);
+	atomic_thread_fence_release();
+#endif
+	return arena;
+}
+
+void
+memory_arena_deallocate(memory_arena_t* arena) {
+	if (!arena)
+		return;
+#if BUILD_ENABLE_ASSERT
+	for (size_t iarena = 0; iarena < get_thread_memory_arena_depth(); ++iarena)
+		FOUNDATION_ASSERT_MSG(get_thread_memory_arena_stack()[iarena] != arena,
+		                      "Deallocating an active memory arena");
+#endif
+
+	while (arena->block) {
+		memory_arena_block_t* next = arena->block->next;
+		_memory_arena_block_deallocate(arena, arena->block);
+		arena->block = next;
+	}
+#if BUILD_ENABLE_MEMORY_STATISTICS
+	atomic_decr32(&_memory_stats.arenas_current, memory_order_relaxed);
+	atomic_thread_fence_release();
+#endif
+	memory_deallocate(arena);
+}
+
+size_t
+memory_arena_size(const memory_arena_t* arena) {
+	return arena ? arena->reserved : 0;
+}
+
+void
+memory_arena_reset(memory_arena_t* arena) {
+	memory_arena_block_t* block = arena->block;
+	if (!block)
+		return;
+
+	arena->last = nullptr;
+	if (!block->next) {
+		block->used = 0;
+		return;
+	}
+
+	//Replace the blocks with a single one able to hold it all, so that an arena
+	//reused for the same work settles without allocating any new block
+	size_t reserved = arena->reserved;
+	while (arena->block) {
+		memory_arena_block_t* next = arena->block->next;
+		_memory_arena_block_deallocate(arena, arena->block);
+		arena->block = next;
+	}
+	_memory_arena_block_allocate(arena, reserved);
+}
+
+void
+memory_arena_push(memory_arena_t* arena) {
+	size_t depth = get_thread_memory_arena_depth();
+	FOUNDATION_ASSERT_MSG(depth < MEMORY_ARENA_STACK_DEPTH, "Memory arena stack overflow");
+	if (depth < MEMORY_ARENA_STACK_DEPTH) {
+		get_thread_memory_arena_stack()[depth] = arena;
+		set_thread_memory_arena_depth(depth + 1);
+	}
+}
+
+void
+memory_arena_pop(void) {
+	size_t depth = get_thread_memory_arena_depth();
+	if (depth > 0)
+		set_thread_memory_arena_depth(depth - 1);
+}
+
+memory_arena_t*
+memory_arena(void) {
+	return _memory_arena_active();
+}
+
+void*
+memory_scratch_allocate(size_t size, unsigned int align) {
+	memory_arena_t* scratch = get_thread_memory_scratch();
+	if (!scratch) {
+		scratch = memory_arena_allocate(HASH_MEMORY, MEMORY_SCRATCH_BLOCK_SIZE);
+		set_thread_memory_scratch(scratch);
+	}
+	return _memory_arena_allocate(scratch, size, align, 0);
+}
+
+void
+memory_scratch_reset(void) {
+	memory_arena_t* scratch = get_thread_memory_scratch();
+	if (scratch)
+		memory_arena_reset(scratch);
+}
+
+static void
+_memory_scratch_finalize(void) {
+	memory_arena_deallocate(get_thread_memory_scratch());
+	set_thread_memory_scratch(nullptr);
+}
+
+size_t
+memory_thread_allocations(void) {
+#if BUILD_ENABLE_MEMORY_STATISTICS
+	return get_thread_memory_allocations();
+#else
+	return 0;
+#endif
+}
+
+bool
+memory_arena_owns(const memory_arena_t* arena, const void* p) {
+	for (memory_arena_block_t* block = arena->block; block; block = block->next) {
+		const void* data = _memory_arena_block_data(block);
+		if ((p >= data) && (p < pointer_offset_const(data, block->size)))
+			return true;
+	}
+	return false;
+}
+
 #if BUILD_ENABLE_MEMORY_CONTEXT
 
 FOUNDATION_DECLARE_THREAD_LOCAL(memory_context_t*, memory_context, 0)
@@ -185,7 +546,7 @@ memory_context_push(hash_t context_id) {
 	if (!context) {
 		context = memory_allocate(0, sizeof(memory_context_t) +
 		                          (sizeof(hash_t) * foundation_config().memory_context_depth),
-		                          0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		                          0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED | MEMORY_NO_ARENA);
 		set_thread_memory_context(context);
 	}
 	context->context[ context->depth ] = context_id;
@@ -249,6 +610,7 @@ memory_thread_initialize(void) {
 
 void
 memory_thread_finalize(void) {
+	_memory_scratch_finalize();
 	if (_memory_system.thread_finalize)
 		_memory_system.thread_finalize();
 }
@@ -370,6 +732,329 @@ memory_system_malloc(void) {
 	return memsystem;
 }
 
+//Thread caching memory system. Small blocks are carved from spans into size classes,
+//freed blocks go to a per-thread free list of the class and are handed back to the
+//central free list of the class in batches once the thread list grows too long.
+//Each block is preceded by a header holding the size class and the offset back to
+//the start of the underlying memory, which also allows aligned and large blocks to be
+//allocated directly from malloc.
+
+#define MEMORY_CACHE_HEADER_SIZE 16
+#define MEMORY_CACHE_SMALL_LIMIT (32 * 1024)
+#define MEMORY_CACHE_CLASS_MAP_SIZE ((MEMORY_CACHE_SMALL_LIMIT / 16) + 1)
+#define MEMORY_CACHE_CLASS_COUNT 83
+#define MEMORY_CACHE_CLASS_LARGE 0xFFFFFFFFU
+#define MEMORY_CACHE_SPAN_SIZE (64 * 1024)
+#define MEMORY_CACHE_BATCH_BYTES (8 * 1024)
+
+typedef struct memory_cache_header_t memory_cache_header_t;
+typedef struct memory_cache_block_t memory_cache_block_t;
+typedef struct memory_cache_bin_t memory_cache_bin_t;
+typedef struct memory_cache_central_t memory_cache_central_t;
+typedef struct memory_cache_span_t memory_cache_span_t;
+typedef struct memory_cache_t memory_cache_t;
+
+struct memory_cache_header_t {
+	uint32_t size_class;
+	uint32_t offset;
+	uint64_t size;
+};
+
+struct memory_cache_block_t {
+	memory_cache_block_t* next;
+};
+
+struct memory_cache_bin_t {
+	memory_cache_block_t* free;
+	size_t count;
+};
+
+FOUNDATION_ALIGNED_STRUCT(memory_cache_central_t, 64) {
+	atomic32_t lock;
+	memory_cache_block_t* free;
+	size_t count;
+};
+
+FOUNDATION_ALIGNED_STRUCT(memory_cache_span_t, 16) {
+	memory_cache_span_t* next;
+	size_t size;
+};
+
+struct memory_cache_t {
+	memory_cache_bin_t bin[MEMORY_CACHE_CLASS_COUNT];
+};
+
+static uint32_t _memory_cache_class_size[MEMORY_CACHE_CLASS_COUNT];
+static uint32_t _memory_cache_class_batch[MEMORY_CACHE_CLASS_COUNT];
+static uint8_t _memory_cache_class_map[MEMORY_CACHE_CLASS_MAP_SIZE];
+static memory_cache_central_t _memory_cache_central[MEMORY_CACHE_CLASS_COUNT];
+static atomic32_t _memory_cache_span_lock;
+static memory_cache_span_t* _memory_cache_span;
+
+FOUNDATION_DECLARE_THREAD_LOCAL(memory_cache_t*, memory_cache, 0)
+
+static void
+_memory_cache_lock(atomic32_t* lock) {
+	while (!atomic_cas32(lock, 1, 0, memory_order_acquire, memory_order_relaxed))
+		thread_yield();
+}
+
+static void
+_memory_cache_unlock(atomic32_t* lock) {
+	atomic_store32(lock, 0, memory_order_release);
+}
+
+static memory_cache_header_t*
+_memory_cache_header(void* p) {
+	return pointer_offset(p, -MEMORY_CACHE_HEADER_SIZE);
+}
+
+static memory_cache_t*
+_memory_cache_thread(void) {
+	memory_cache_t* cache = get_thread_memory_cache();
+	if (!cache) {
+		cache = calloc(1, sizeof(memory_cache_t));
+		set_thread_memory_cache(cache);
+	}
+	return cache;
+}
+
+static memory_cache_block_t*
+_memory_cache_span_allocate(uint32_t size_class) {
+	//Carve a new span into blocks of the class, linked in address order
+	const size_t block_size = _memory_cache_class_size[size_class];
+	size_t span_size = MEMORY_CACHE_SPAN_SIZE;
+	if (span_size < sizeof(memory_cache_span_t) + (block_size * _memory_cache_class_batch[size_class]))
+		span_size = sizeof(memory_cache_span_t) + (block_size * _memory_cache_class_batch[size_class]);
+	memory_cache_span_t* span = malloc(span_size);
+	if (!span)
+		return nullptr;
+
+	span->size = span_size;
+	_memory_cache_lock(&_memory_cache_span_lock);
+	span->next = _memory_cache_span;
+	_memory_cache_span = span;
+	_memory_cache_unlock(&_memory_cache_span_lock);
+
+	const size_t count = (span_size - sizeof(memory_cache_span_t)) / block_size;
+	memory_cache_block_t* first = pointer_offset(span, sizeof(memory_cache_span_t));
+	memory_cache_block_t* block = first;
+	for (size_t iblock = 1; iblock < count; ++iblock) {
+		block->next = pointer_offset(block, block_size);
+		block = block->next;
+	}
+	block->next = nullptr;
+	return first;
+}
+
+static void
+_memory_cache_refill(memory_cache_bin_t* bin, uint32_t size_class) {
+	memory_cache_central_t* central = _memory_cache_central + size_class;
+	const size_t batch = _memory_cache_class_batch[size_class];
+
+	_memory_cache_lock(&central->lock);
+	memory_cache_block_t* first = central->free;
+	if (first) {
+		memory_cache_block_t* last = first;
+		size_t count = 1;
+		while ((count < batch) && last->next) {
+			last = last->next;
+			++count;
+		}
+		central->free = last->next;
+		central->count -= count;
+		last->next = nullptr;
+		bin->free = first;
+		bin->count = count;
+	}
+	_memory_cache_unlock(&central->lock);
+
+	if (!first) {
+		first = _memory_cache_span_allocate(size_class);
+		size_t count = 0;
+		for (memory_cache_block_t* block = first; block; block = block->next)
+			++count;
+		bin->free = first;
+		bin->count = count;
+	}
+}
+
+static void
+_memory_cache_release(memory_cache_bin_t* bin, uint32_t size_class, size_t count) {
+	//Hand the given number of blocks from the head of the thread list to the central list
+	if (!count)
+		return;
+	memory_cache_block_t* first = bin->free;
+	memory_cache_block_t* last = first;
+	for (size_t iblock = 1; iblock < count; ++iblock)
+		last = last->next;
+	bin->free = last->next;
+	bin->count -= count;
+
+	memory_cache_central_t* central = _memory_cache_central + size_class;
+	_memory_cache_lock(&central->lock);
+	last->next = central->free;
+	central->free = first;
+	central->count += count;
+	_memory_cache_unlock(&central->lock);
+}
+
+static void*
+_memory_cache_allocate_large(size_t size, unsigned int align) {
+	size_t offset = MEMORY_CACHE_HEADER_SIZE;
+	if (align > MEMORY_CACHE_HEADER_SIZE)
+		offset = align;
+	void* memory = malloc(size + offset + (align > FOUNDATION_MIN_ALIGN ? align : 0));
+	if (!memory)
+		return nullptr;
+	uintptr_t start = (uintptr_t)pointer_offset(memory, offset);
+	if (align > FOUNDATION_MIN_ALIGN)
+		start = (start + (align - 1)) & ~(uintptr_t)(align - 1);
+
+	memory_cache_header_t* header = _memory_cache_header((void*)start);
+	header->size_class = MEMORY_CACHE_CLASS_LARGE;
+	header->offset = (uint32_t)(start - (uintptr_t)memory);
+	header->size = size;
+	return (void*)start;
+}
+
+static void*
+_memory_allocate_cache(hash_t context, size_t size, unsigned int align, unsigned int hint) {
+	FOUNDATION_UNUSED(context);
+	void* p;
+	const size_t total = size + MEMORY_CACHE_HEADER_SIZE;
+	if ((align <= FOUNDATION_MIN_ALIGN) && (total <= MEMORY_CACHE_SMALL_LIMIT)) {
+		const uint32_t size_class = _memory_cache_class_map[(total + 15) >> 4];
+		memory_cache_bin_t* bin = _memory_cache_thread()->bin + size_class;
+		if (!bin->free)
+			_memory_cache_refill(bin, size_class);
+		memory_cache_block_t* block = bin->free;
+		if (block) {
+			bin->free = block->next;
+			--bin->count;
+			memory_cache_header_t* header = (memory_cache_header_t*)block;
+			header->size_class = size_class;
+			header->offset = MEMORY_CACHE_HEADER_SIZE;
+		}
+		p = block ? pointer_offset(block, MEMORY_CACHE_HEADER_SIZE) : nullptr;
+	}
+	else {
+		p = _memory_cache_allocate_large(size, align);
+	}
+
+	if (!p) {
+		log_errorf(HASH_MEMORY, ERROR_OUT_OF_MEMORY,
+		           STRING_CONST("Unable to allocate %" PRIsize " bytes of memory"), size);
+		return nullptr;
+	}
+	if (hint & MEMORY_ZERO_INITIALIZED)
+		memset(p, 0, size);
+	return p;
+}
+
+static void
+_memory_deallocate_cache(void* p) {
+	if (!p)
+		return;
+
+	memory_cache_header_t* header = _memory_cache_header(p);
+	const uint32_t size_class = header->size_class;
+	if (size_class == MEMORY_CACHE_CLASS_LARGE) {
+		free(pointer_offset(p, -(ptrdiff_t)header->offset));
+		return;
+	}
+
+	FOUNDATION_ASSERT_MSG(size_class < MEMORY_CACHE_CLASS_COUNT, "Invalid memory block");
+	memory_cache_bin_t* bin = _memory_cache_thread()->bin + size_class;
+	memory_cache_block_t* block = (memory_cache_block_t*)header;
+	block->next = bin->free;
+	bin->free = block;
+	if (++bin->count >= 2 * _memory_cache_class_batch[size_class])
+		_memory_cache_release(bin, size_class, _memory_cache_class_batch[size_class]);
+}
+
+static void*
+_memory_reallocate_cache(void* p, size_t size, unsigned int align, size_t oldsize, unsigned int hint) {
+	if (p) {
+		//Keep the block if it is large enough and properly aligned
+		memory_cache_header_t* header = _memory_cache_header(p);
+		const size_t capacity = (header->size_class == MEMORY_CACHE_CLASS_LARGE) ? (size_t)header->size :
+		                        (_memory_cache_class_size[header->size_class] - MEMORY_CACHE_HEADER_SIZE);
+		if ((size <= capacity) && !((uintptr_t)p & (uintptr_t)(align ? align - 1 : 0)))
+			return p;
+	}
+
+	void* memory = _memory_allocate_cache(0, size, align, hint & ~(unsigned int)MEMORY_ZERO_INITIALIZED);
+	if (p && memory && oldsize && !(hint & MEMORY_NO_PRESERVE))
+		memcpy(memory, p, (size < oldsize) ? (size_t)size : (size_t)oldsize);
+	_memory_deallocate_cache(p);
+	return memory;
+}
+
+static void
+_memory_thread_finalize_cache(void) {
+	memory_cache_t* cache = get_thread_memory_cache();
+	if (!cache)
+		return;
+	for (uint32_t size_class = 0; size_class < MEMORY_CACHE_CLASS_COUNT; ++size_class)
+		_memory_cache_release(cache->bin + size_class, size_class, cache->bin[size_class].count);
+	free(cache);
+	set_thread_memory_cache(nullptr);
+}
+
+static int
+_memory_initialize_cache(void) {
+	//Classes in steps of 16 bytes up to 1KiB, then four classes per power of two
+	uint32_t size_class = 0;
+	for (uint32_t size = 32; size <= 1024; size += 16)
+		_memory_cache_class_size[size_class++] = size;
+	for (uint32_t base = 1024; base < MEMORY_CACHE_SMALL_LIMIT; base <<= 1) {
+		for (uint32_t step = 1; step <= 4; ++step)
+			_memory_cache_class_size[size_class++] = base + ((base / 4) * step);
+	}
+	FOUNDATION_ASSERT(size_class == MEMORY_CACHE_CLASS_COUNT);
+
+	size_class = 0;
+	for (size_t islot = 0; islot < MEMORY_CACHE_CLASS_MAP_SIZE; ++islot) {
+		while (_memory_cache_class_size[size_class] < (islot << 4))
+			++size_class;
+		_memory_cache_class_map[islot] = (uint8_t)size_class;
+	}
+
+	for (size_class = 0; size_class < MEMORY_CACHE_CLASS_COUNT; ++size_class) {
+		uint32_t batch = MEMORY_CACHE_BATCH_BYTES / _memory_cache_class_size[size_class];
+		_memory_cache_class_batch[size_class] = (batch < 4) ? 4 : ((batch > 64) ? 64 : batch);
+	}
+
+	memset(_memory_cache_central, 0, sizeof(_memory_cache_central));
+	_memory_cache_span = nullptr;
+	return 0;
+}
+
+static void
+_memory_finalize_cache(void) {
+	_memory_thread_finalize_cache();
+	while (_memory_cache_span) {
+		memory_cache_span_t* next = _memory_cache_span->next;
+		free(_memory_cache_span);
+		_memory_cache_span = next;
+	}
+	memset(_memory_cache_central, 0, sizeof(_memory_cache_central));
+}
+
+memory_system_t
+memory_system_thread_cache(void) {
+	memory_system_t memsystem;
+	memset(&memsystem, 0, sizeof(memsystem));
+	memsystem.allocate = _memory_allocate_cache;
+	memsystem.reallocate = _memory_reallocate_cache;
+	memsystem.deallocate = _memory_deallocate_cache;
+	memsystem.thread_finalize = _memory_thread_finalize_cache;
+	memsystem.initialize = _memory_initialize_cache;
+	memsystem.finalize = _memory_finalize_cache;
+	return memsystem;
+}
+
 #if BUILD_ENABLE_MEMORY_TRACKER
 
 void
@@ -399,15 +1084,16 @@ memory_set_tracker(memory_tracker_t tracker) {
 }
 
 static void
-_memory_track(void* addr, size_t size) {
+_memory_track(void* addr, size_t size, hash_t context) {
 	if (_memory_tracker.track)
-		_memory_tracker.track(addr, size);
+		_memory_tracker.track(addr, size, context);
 }
 
-static void
+static hash_t
 _memory_untrack(void* addr) {
 	if (_memory_tracker.untrack)
-		_memory_tracker.untrack(addr);
+		return _memory_tracker.untrack(addr);
+	return 0;
 }
 
 void
@@ -419,20 +1105,76 @@ memory_tracker_dump(memory_tracker_handler_fn handler) {
 FOUNDATION_ALIGNED_STRUCT(memory_tag_t, 8) {
 	atomicptr_t   address;
 	size_t        size;
+	hash_t        context;
 	void*         trace[14];
 };
 
 typedef struct memory_tag_t memory_tag_t;
 
+//Current usage per memory context, slots are claimed by the first allocation in a context
+#define MEMORY_TRACKER_CONTEXT_COUNT 64
+
+FOUNDATION_ALIGNED_STRUCT(memory_context_usage_t, 8) {
+	atomic64_t    context;
+	atomic64_t    allocated;
+	atomic32_t    allocations;
+};
+
+typedef struct memory_context_usage_t memory_context_usage_t;
+
 static memory_tag_t* _memory_tags;
 static atomic32_t    _memory_tag_next;
 static bool          _memory_tracker_initialized;
+static memory_context_usage_t _memory_context_usage[MEMORY_TRACKER_CONTEXT_COUNT];
+
+static memory_context_usage_t*
+_memory_tracker_context_usage(hash_t context, bool claim) {
+	if (!context)
+		return nullptr;
+	for (size_t islot = 0; islot < MEMORY_TRACKER_CONTEXT_COUNT; ++islot) {
+		memory_context_usage_t* usage = _memory_context_usage + islot;
+		hash_t slot_context = (hash_t)atomic_load64(&usage->context, memory_order_acquire);
+		if (slot_context == context)
+			return usage;
+		if (!slot_context) {
+			if (!claim)
+				return nullptr;
+			if (atomic_cas64(&usage->context, (int64_t)context, 0, memory_order_release, memory_order_acquire))
+				return usage;
+			if ((hash_t)atomic_load64(&usage->context, memory_order_acquire) == context)
+				return usage;
+		}
+	}
+	return nullptr;
+}
+
+static void
+_memory_tracker_context_add(hash_t context, int32_t allocations, int64_t size) {
+	memory_context_usage_t* usage = _memory_tracker_context_usage(context, allocations > 0);
+	if (usage) {
+		atomic_add32(&usage->allocations, allocations, memory_order_relaxed);
+		atomic_add64(&usage->allocated, size, memory_order_relaxed);
+	}
+}
+
+static memory_statistics_t
+_memory_tracker_context_statistics(hash_t context) {
+	memory_statistics_t stats;
+	memset(&stats, 0, sizeof(stats));
+	memory_context_usage_t* usage = _memory_tracker_context_usage(context, false);
+	if (usage) {
+		stats.allocations_current = (uint32_t)atomic_load32(&usage->allocations, memory_order_relaxed);
+		stats.allocated_current = (uint32_t)atomic_load64(&usage->allocated, memory_order_relaxed);
+	}
+	return stats;
+}
 
 static int
 _memory_tracker_initialize(void) {
 	if (!_memory_tracker_initialized) {
 		size_t size = sizeof(memory_tag_t) * foundation_config().memory_tracker_max;
 		_memory_tags = memory_allocate(0, size, 8, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		memset(_memory_context_usage, 0, sizeof(_memory_context_usage));
 
 #if BUILD_ENABLE_MEMORY_STATISTICS
 		atomic_incr32(&_memory_stats.allocations_total, memory_order_relaxed);
@@ -503,7 +1245,7 @@ _memory_tracker_dump(memory_tracker_handler_fn handler) {
 }
 
 static void
-_memory_tracker_track(void* addr, size_t size) {
+_memory_tracker_track(void* addr, size_t size, hash_t context) {
 	if (addr && _memory_tracker_initialized) {
 		size_t limit = foundation_config().memory_tracker_max * 2;
 		size_t loop = 0;
@@ -520,6 +1262,8 @@ _memory_tracker_track(void* addr, size_t size) {
 			if (atomic_cas_ptr(&_memory_tags[tag].address, addr, nullptr,
 			                   memory_order_release, memory_order_acquire)) {
 				_memory_tags[tag].size = size;
+				_memory_tags[tag].context = context;
+				_memory_tracker_context_add(context, 1, (int64_t)size);
 				stacktrace_capture(_memory_tags[tag].trace,
 				                   sizeof(_memory_tags[tag].trace)/sizeof(_memory_tags[tag].trace[0]), 3);
 				break;
@@ -547,10 +1291,11 @@ _memory_tracker_track(void* addr, size_t size) {
 	//}
 }
 
-static void
+static hash_t
 _memory_tracker_untrack(void* addr) {
 	int32_t tag = 0;
 	size_t size = 0;
+	hash_t context = 0;
 	if (addr && _memory_tracker_initialized) {
 		int32_t maxtag = (int32_t)foundation_config().memory_tracker_max;
 		int32_t iend = atomic_load32(&_memory_tag_next, memory_order_acquire) % maxtag;
@@ -560,6 +1305,7 @@ _memory_tracker_untrack(void* addr) {
 			if (addr == tagaddr) {
 				tag = itag;
 				size = _memory_tags[itag].size;
+				context = _memory_tags[itag].context;
 				break;
 			}
 			if (itag == iend)
@@ -572,6 +1318,7 @@ _memory_tracker_untrack(void* addr) {
 	}
 	if (size) {
 		atomic_store_ptr(&_memory_tags[tag].address, nullptr, memory_order_release);
+		_memory_tracker_context_add(context, -1, -(int64_t)size);
 #if BUILD_ENABLE_MEMORY_STATISTICS
 		atomic_decr32(&_memory_stats.allocations_current, memory_order_relaxed);
 		atomic_add32(&_memory_stats.allocated_current, -(int32_t)size, memory_order_relaxed);
@@ -581,6 +1328,7 @@ _memory_tracker_untrack(void* addr) {
 	//else if (addr) {
 	//	log_warnf(HASH_MEMORY, WARNING_SUSPICIOUS, STRING_CONST("Pre-init untracked deallocation: 0x%" PRIfixPTR), (uintptr_t)addr);
 	//}
+	return context;
 }
 
 #endif
@@ -592,6 +1340,7 @@ memory_tracker_local(void) {
 	tracker.track = _memory_tracker_track;
 	tracker.untrack = _memory_tracker_untrack;
 	tracker.dump = _memory_tracker_dump;
+	tracker.context_statistics = _memory_tracker_context_statistics;
 	tracker.initialize = _memory_tracker_initialize;
 	tracker.abort = _memory_tracker_cleanup;
 	tracker.finalize = _memory_tracker_finalize;
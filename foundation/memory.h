@@ -24,7 +24,15 @@ at compile time.
 
 Memory can be tracked by context, set as a hash value (usually a static string hash) if the build
 configuration #BUILD_ENABLE_MEMORY_CONTEXT is set to 1. If not, all memory context calls are statically
-removed and context 0 is used everywhere. Memory contexts are stored per thread. */
+removed and context 0 is used everywhere. Memory contexts are stored per thread.
+
+Memory arenas hand out memory from large blocks and release it all at once. An arena can be
+pushed as the active arena on a thread, in which case all allocations made through
+#memory_allocate and #memory_reallocate on that thread are served by the arena (unless given
+the #MEMORY_NO_ARENA hint), and deallocating arena memory is a no-op. Memory obtained from an
+arena must not be deallocated once the arena is no longer active (which asserts), it is released
+with the arena itself. Arena allocations carry a small header identifying the arena, so telling
+them apart from memory system blocks does not search the arena blocks. */
 
 #include <foundation/platform.h>
 #include <foundation/types.h>
@@ -87,6 +95,77 @@ Called internally when a foundation thread is about to exit. */
 FOUNDATION_API void
 memory_context_thread_finalize(void);
 
+/*! Allocate a memory arena. Blocks are allocated from the memory system as needed, starting
+at the given block size and growing with the total amount of memory handed out.
+\param context    Memory context used for the arena blocks
+\param block_size Size of the first block, zero for default (64KiB)
+\return           New memory arena */
+FOUNDATION_API memory_arena_t*
+memory_arena_allocate(hash_t context, size_t block_size);
+
+/*! Deallocate a memory arena and all memory handed out from it in one go. The arena must
+not be active on any thread.
+\param arena Memory arena */
+FOUNDATION_API void
+memory_arena_deallocate(memory_arena_t* arena);
+
+/*! Get the amount of memory reserved by an arena, i.e. the total size of its blocks
+\param arena Memory arena
+\return      Size of the arena blocks in bytes, 0 if arena is null */
+FOUNDATION_API size_t
+memory_arena_size(const memory_arena_t* arena);
+
+/*! Release all memory handed out from an arena. The arena keeps a single block able to hold
+as much memory as was handed out, so it can be reused without allocating.
+\param arena Memory arena */
+FOUNDATION_API void
+memory_arena_reset(memory_arena_t* arena);
+
+/*! Make an arena the active arena of the calling thread by pushing it onto the thread arena
+stack. A call to #memory_arena_pop will restore the previously active arena. An arena
+must only be active on a single thread at a time. Pushing a null arena suspends arena
+allocations until popped.
+\param arena Memory arena */
+FOUNDATION_API void
+memory_arena_push(memory_arena_t* arena);
+
+/*! Pop the active arena off the thread arena stack, restoring the previously active arena */
+FOUNDATION_API void
+memory_arena_pop(void);
+
+/*! Get the active arena of the calling thread
+\return Active memory arena, null if none */
+FOUNDATION_API memory_arena_t*
+memory_arena(void);
+
+/*! Allocate scratch memory from the per-thread scratch arena. Scratch memory is valid until
+the next call to #memory_scratch_reset on the same thread (usually at the end of a frame)
+and must not be deallocated.
+\param size  Requested size
+\param align Requested alignment
+\return      Memory address to a memory block of the requested size and alignment,
+              0 if out of memory */
+FOUNDATION_API void*
+memory_scratch_allocate(size_t size, unsigned int align);
+
+/*! Release all scratch memory allocated by the calling thread */
+FOUNDATION_API void
+memory_scratch_reset(void);
+
+/*! Get the number of allocations and reallocations the calling thread made through the memory
+system (arena and scratch memory excluded), as a running counter. Only counted if the build
+configuration #BUILD_ENABLE_MEMORY_STATISTICS is set to 1, zero otherwise.
+\return Number of allocations made by the calling thread */
+FOUNDATION_API size_t
+memory_thread_allocations(void);
+
+/*! Query if memory was handed out by the given arena
+\param arena Memory arena
+\param p     Memory block pointer
+\return      true if p points inside a block of the arena, false if not */
+FOUNDATION_API bool
+memory_arena_owns(const memory_arena_t* arena, const void* p);
+
 /*! Initialize per-thread resources used by memory system.
 Called internally when a foundation thread is about to start. */
 FOUNDATION_API void
@@ -109,11 +188,28 @@ memory_set_tracker(memory_tracker_t tracker);
 FOUNDATION_API void
 memory_tracker_dump(memory_tracker_handler_fn handler);
 
+/*! Get the current memory statistics of a memory context, as recorded by the memory tracker.
+Only the current allocation count and allocated bytes are set, and only if the tracker
+keeps statistics per context (like #memory_tracker_local).
+\param context Memory context
+\return Memory statistics of the context */
+FOUNDATION_API memory_statistics_t
+memory_context_statistics(hash_t context);
+
 /*! Get the default malloc based memory system declaration for passing to #foundation_initialize
 \return Default malloc based memory system declation */
 FOUNDATION_API memory_system_t
 memory_system_malloc(void);
 
+/*! Get the thread caching memory system declaration for passing to #foundation_initialize.
+Small blocks are served from per-thread free lists of size classes, refilled from and
+returned to a central heap in batches, which avoids contention on the global heap when
+many threads allocate concurrently. Large and over-aligned blocks are allocated directly
+from the system heap.
+\return Thread caching memory system declaration */
+FOUNDATION_API memory_system_t
+memory_system_thread_cache(void);
+
 /*! Get the default local memory tracker declaration for passing to #memory_set_tracker
 \return Default local memory tracker declaration */
 FOUNDATION_API memory_tracker_t
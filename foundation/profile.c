@@ -627,6 +627,291 @@ profile_identifier(void) {
 	return _profile_identifier;
 }
 
+//Chrome Trace Event output, converting blocks to JSON events as the io thread writes them.
+//Messages split over continuation blocks are accumulated until the next non-continuation
+//block arrives.
+
+#define PROFILE_TRACE_MESSAGE_LENGTH 256
+
+typedef struct profile_trace_message_t profile_trace_message_t;
+
+struct profile_trace_message_t {
+	int32_t  id;
+	uint32_t thread;
+	tick_t   start;
+	tick_t   counter;
+	size_t   length;
+	char     name[PROFILE_TRACE_MESSAGE_LENGTH];
+};
+
+static stream_t*               _profile_trace_stream;
+static size_t                  _profile_trace_events;
+static profile_trace_message_t _profile_trace_message;
+
+static size_t
+_profile_trace_escape(char* buffer, size_t capacity, const char* str, size_t length) {
+	size_t written = 0;
+	for (size_t ichar = 0; (ichar < length) && str[ichar] && (written + 2 < capacity); ++ichar) {
+		char c = str[ichar];
+		if ((c == '"') || (c == '\\'))
+			buffer[written++] = '\\';
+		else if ((unsigned char)c < 0x20)
+			c = ' ';
+		buffer[written++] = c;
+	}
+	buffer[written] = 0;
+	return written;
+}
+
+static double
+_profile_trace_time(tick_t ticks) {
+	return ((double)ticks * 1000000.0) / (double)time_ticks_per_second();
+}
+
+static void
+_profile_trace_write_event(const char* event, size_t length) {
+	if (_profile_trace_events++)
+		stream_write(_profile_trace_stream, STRING_CONST(",\n"));
+	stream_write(_profile_trace_stream, event, length);
+}
+
+static void
+_profile_trace_flush_message(void) {
+	profile_trace_message_t* message = &_profile_trace_message;
+	if (!message->id)
+		return;
+
+	const char* category = "lock";
+	const char* prefix = "";
+	switch (message->id) {
+	case PROFILE_ID_LOGMESSAGE: category = "log"; break;
+	case PROFILE_ID_TRYLOCK: prefix = "trylock "; break;
+	case PROFILE_ID_LOCK: prefix = "lock "; break;
+	case PROFILE_ID_UNLOCK: prefix = "unlock "; break;
+	case PROFILE_ID_WAIT: prefix = "wait "; break;
+	case PROFILE_ID_SIGNAL: prefix = "signal "; break;
+	default: break;
+	}
+
+	char name[PROFILE_TRACE_MESSAGE_LENGTH * 2];
+	char event[PROFILE_TRACE_MESSAGE_LENGTH * 3];
+	_profile_trace_escape(name, sizeof(name), message->name, message->length);
+	string_t json = string_format(event, sizeof(event),
+	                              STRING_CONST("{\"name\":\"%s%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+	                                           "\"ts\":%.3f,\"pid\":1,\"tid\":%u}"),
+	                              prefix, name, category, _profile_trace_time(message->start),
+	                              message->thread);
+	_profile_trace_write_event(STRING_ARGS(json));
+	message->id = 0;
+}
+
+static void
+_profile_trace_end(void) {
+	_profile_trace_flush_message();
+	stream_write(_profile_trace_stream, STRING_CONST("\n]}\n"));
+	stream_deallocate(_profile_trace_stream);
+	_profile_trace_stream = nullptr;
+}
+
+static void
+_profile_trace_write(void* data, size_t size) {
+	FOUNDATION_UNUSED(size);
+	if (!_profile_trace_stream)
+		return;
+
+	const profile_block_data_t* block = &((const profile_block_t*)data)->data;
+	const int32_t id = block->id;
+	profile_trace_message_t* message = &_profile_trace_message;
+
+	//Continuation blocks of a message have the id of the message plus one, and are linked
+	//to the previous block through its counter
+	if (message->id && block->parentid && (id == message->id + 1) &&
+	        ((tick_t)block->parentid == message->counter)) {
+		const size_t length = string_length(block->name);
+		if (message->length + length < sizeof(message->name)) {
+			memcpy(message->name + message->length, block->name, length);
+			message->length += length;
+		}
+		message->counter = block->end;
+		return;
+	}
+	_profile_trace_flush_message();
+
+	char name[(MAX_MESSAGE_LENGTH * 2) + 1];
+	char event[256];
+	string_t json = {0, 0};
+	switch (id) {
+	case PROFILE_ID_ENDOFSTREAM:
+		_profile_trace_end();
+		return;
+
+	case PROFILE_ID_SYSTEMINFO:
+		return;
+
+	case PROFILE_ID_ENDFRAME:
+		json = string_format(event, sizeof(event),
+		                     STRING_CONST("{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"g\","
+		                                  "\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%" PRIu64 "}}"),
+		                     _profile_trace_time(block->start), block->thread, (uint64_t)block->end);
+		break;
+
+	case PROFILE_ID_LOGMESSAGE:
+	case PROFILE_ID_TRYLOCK:
+	case PROFILE_ID_LOCK:
+	case PROFILE_ID_UNLOCK:
+	case PROFILE_ID_WAIT:
+	case PROFILE_ID_SIGNAL:
+		message->id = id;
+		message->thread = block->thread;
+		message->start = block->start;
+		message->counter = block->end;
+		message->length = string_copy(message->name, sizeof(message->name), block->name,
+		                              string_length(block->name)).length;
+		return;
+
+	default:
+		_profile_trace_escape(name, sizeof(name), block->name, sizeof(block->name));
+		json = string_format(event, sizeof(event),
+		                     STRING_CONST("{\"name\":\"%s\",\"cat\":\"block\",\"ph\":\"X\",\"ts\":%.3f,"
+		                                  "\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"cpu\":%u}}"),
+		                     name, _profile_trace_time(block->start),
+		                     _profile_trace_time(block->end - block->start), block->thread, block->processor);
+		break;
+	}
+
+	_profile_trace_write_event(STRING_ARGS(json));
+}
+
+static bool
+_profile_trace_begin(const char* path, size_t length) {
+	if (_profile_trace_stream)
+		_profile_trace_end();
+
+	_profile_trace_stream = fs_open_file(path, length, STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE | STREAM_BINARY);
+	if (!_profile_trace_stream) {
+		log_warnf(0, WARNING_SUSPICIOUS, STRING_CONST("Unable to open profile trace file: %.*s"),
+		          (int)length, path);
+		return false;
+	}
+
+	char name[128];
+	char event[256];
+	_profile_trace_events = 0;
+	memset(&_profile_trace_message, 0, sizeof(_profile_trace_message));
+	_profile_trace_escape(name, sizeof(name), STRING_ARGS(_profile_identifier));
+	string_t json = string_format(event, sizeof(event),
+	                              STRING_CONST("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+	                                           "\"args\":{\"name\":\"%s\"}}"), name);
+	stream_write(_profile_trace_stream, STRING_CONST("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"));
+	_profile_trace_write_event(STRING_ARGS(json));
+	return true;
+}
+
+bool
+profile_set_output_trace(const char* path, size_t length) {
+	if (!_profile_trace_begin(path, length))
+		return false;
+
+	profile_set_output(_profile_trace_write);
+	return true;
+}
+
+//Profile history, keeping the last blocks in a ring buffer until a capture of a time window
+//is requested. The io thread writes the capture once it receives blocks past the window.
+
+#define PROFILE_CAPTURE_IDLE     0
+#define PROFILE_CAPTURE_SETUP    1
+#define PROFILE_CAPTURE_PENDING  2
+
+static ringbuffer_t* _profile_history;
+static atomic32_t    _profile_capture_state;
+static tick_t        _profile_capture_from;
+static tick_t        _profile_capture_to;
+static size_t        _profile_capture_length;
+static char          _profile_capture_path[BUILD_MAX_PATHLEN];
+
+static bool
+_profile_capture_in_window(const profile_block_data_t* block) {
+	//Regular blocks are kept if they overlap the window, frame and message blocks (which
+	//store a counter as end value) if they were emitted within it
+	if (block->id > PROFILE_ID_SIGNAL + 1)
+		return (block->start <= _profile_capture_to) && (block->end >= _profile_capture_from);
+	return (block->start >= _profile_capture_from) && (block->start <= _profile_capture_to);
+}
+
+static void
+_profile_capture_write(void) {
+	profile_block_t block;
+	bool opened = _profile_trace_begin(_profile_capture_path, _profile_capture_length);
+	while (ringbuffer_read(_profile_history, &block, sizeof(block)) == sizeof(block)) {
+		if (opened && _profile_capture_in_window(&block.data))
+			_profile_trace_write(&block, sizeof(block));
+	}
+	if (_profile_trace_stream)
+		_profile_trace_end();
+	ringbuffer_reset(_profile_history);
+	atomic_store32(&_profile_capture_state, PROFILE_CAPTURE_IDLE, memory_order_release);
+}
+
+static void
+_profile_history_write(void* data, size_t size) {
+	const profile_block_data_t* block = &((const profile_block_t*)data)->data;
+	const bool pending = (atomic_load32(&_profile_capture_state, memory_order_acquire) ==
+	                      PROFILE_CAPTURE_PENDING);
+
+	if (block->id == PROFILE_ID_ENDOFSTREAM) {
+		if (pending)
+			_profile_capture_write();
+		return;
+	}
+	if (block->id == PROFILE_ID_SYSTEMINFO)
+		return;
+
+	if (pending && (block->start > _profile_capture_to))
+		_profile_capture_write();
+
+	//Discard the oldest blocks to make room
+	const size_t capacity = ringbuffer_size(_profile_history) - 1;
+	while ((size_t)(ringbuffer_total_written(_profile_history) -
+	                ringbuffer_total_read(_profile_history)) + size > capacity) {
+		if (!ringbuffer_read(_profile_history, nullptr, size))
+			return;
+	}
+	ringbuffer_write(_profile_history, data, size);
+}
+
+void
+profile_set_output_history(ringbuffer_t* buffer) {
+	if (_profile_trace_stream)
+		_profile_trace_end();
+
+	_profile_history = buffer;
+	atomic_store32(&_profile_capture_state, PROFILE_CAPTURE_IDLE, memory_order_release);
+	if (buffer) {
+		ringbuffer_reset(buffer);
+		profile_set_output(_profile_history_write);
+	}
+	else {
+		profile_set_output(nullptr);
+	}
+}
+
+bool
+profile_capture_trace(const char* path, size_t length, tick_t from, tick_t to) {
+	if (!_profile_history || (length >= sizeof(_profile_capture_path)))
+		return false;
+	if (!atomic_cas32(&_profile_capture_state, PROFILE_CAPTURE_SETUP, PROFILE_CAPTURE_IDLE,
+	                  memory_order_acquire, memory_order_relaxed))
+		return false;
+
+	string_copy(_profile_capture_path, sizeof(_profile_capture_path), path, length);
+	_profile_capture_length = length;
+	_profile_capture_from = from - _profile_ground_time;
+	_profile_capture_to = to - _profile_ground_time;
+	atomic_store32(&_profile_capture_state, PROFILE_CAPTURE_PENDING, memory_order_release);
+	return true;
+}
+
 #endif
 
 void
@@ -57,6 +57,39 @@ output stream you want.
 FOUNDATION_API void
 profile_set_output(profile_write_fn writer);
 
+/*! Set output to a file in Chrome Trace Event JSON format, which can be loaded in
+chrome://tracing or the Perfetto UI. Blocks are written as complete events, frame ends, log
+messages and lock notifications as instant events. The file is completed when the output
+stream ends, i.e. when profiling is disabled or finalized. Call before enabling profiling,
+this replaces the current output function.
+\param path Output file path
+\param length Length of path
+\return true if file was opened, false if not */
+FOUNDATION_API bool
+profile_set_output_trace(const char* path, size_t length);
+
+/*! Set output to a history of the last profile blocks, kept in the given ring buffer, from
+which traces of a time window can be captured with #profile_capture_trace. Older blocks are
+discarded as the ring buffer fills up, so its size determines how far back the history goes.
+The ring buffer must outlive the profiling output. Call before enabling profiling, this
+replaces the current output function.
+\param buffer Ring buffer holding the history, null to disable the history output */
+FOUNDATION_API void
+profile_set_output_history(ringbuffer_t* buffer);
+
+/*! Capture the blocks of a time window from the profile history to a file in Chrome Trace
+Event JSON format, see #profile_set_output_trace. The file is written by the profile output
+thread once it has received blocks past the end of the window (or when the output stream
+ends), after which the history starts over. Only one capture can be pending at a time.
+\param path Output file path
+\param length Length of path
+\param from Start of the window, in ticks as returned by #time_current
+\param to End of the window, in ticks as returned by #time_current
+\return true if the capture was scheduled, false if history output is not set or a capture
+is already pending */
+FOUNDATION_API bool
+profile_capture_trace(const char* path, size_t length, tick_t from, tick_t to);
+
 /*! Control profile output rate by setting time between flushes in milliseconds. Default is
 100ms. Decresee time (increase rate) when passing a smaller buffer to initialization, or
 increase time (decrease rate) if passing a larger buffer.
@@ -145,6 +178,9 @@ profile_identifier(void);
 #define profile_finalize() do {} while(0)
 #define profile_enable(...) do { FOUNDATION_UNUSED_VARARGS(__VA_ARGS__); } while(0)
 #define profile_set_output(fn) do { profile_write_fn tmpfn = fn; FOUNDATION_UNUSED(tmpfn); } while(0)
+#define profile_set_output_trace(path, length) ((void)sizeof(path), (void)sizeof(length), false)
+#define profile_set_output_history(...) do { FOUNDATION_UNUSED_VARARGS(__VA_ARGS__); } while(0)
+#define profile_capture_trace(path, length, from, to) ((void)sizeof(path), (void)sizeof(length), (void)sizeof(from), (void)sizeof(to), false)
 #define profile_set_output_wait(...) do { FOUNDATION_UNUSED_VARARGS(__VA_ARGS__); } while(0)
 #define profile_end_frame(...) do { FOUNDATION_UNUSED_VARARGS(__VA_ARGS__); } while(0)
 #define profile_begin_block_(...) do { FOUNDATION_UNUSED_VARARGS(__VA_ARGS__); } while(0)
@@ -109,6 +109,8 @@ static unsigned int*
 _random_thread_initialize(void) {
 	unsigned int* buffer;
 
+	//State buffers outlive any arena scope of the calling thread
+	memory_arena_push(nullptr);
 	mutex_lock(_random_mutex);
 
 	//Grab a free state buffer or allocate if none available
@@ -122,6 +124,7 @@ _random_thread_initialize(void) {
 	}
 
 	mutex_unlock(_random_mutex);
+	memory_arena_pop();
 
 	set_thread_state(buffer);
 
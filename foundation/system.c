@@ -122,7 +122,8 @@ static char*
 _system_buffer() {
 	char* buffer = get_thread_system_buffer();
 	if (!buffer) {
-		buffer = memory_allocate(0, SYSTEM_BUFFER_SIZE + 1, 0, MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED);
+		buffer = memory_allocate(0, SYSTEM_BUFFER_SIZE + 1, 0,
+		                         MEMORY_PERSISTENT | MEMORY_ZERO_INITIALIZED | MEMORY_NO_ARENA);
 		set_thread_system_buffer(buffer);
 	}
 	return buffer;
@@ -251,6 +252,21 @@ system_hardware_threads(void) {
 	return system_info.dwNumberOfProcessors;
 }
 
+bool
+system_cpu_times(uint64_t* busy, uint64_t* total) {
+	FILETIME idle_time, kernel_time, user_time;
+	if (!GetSystemTimes(&idle_time, &kernel_time, &user_time))
+		return false;
+
+	//Kernel time includes the idle time
+	uint64_t idle = ((uint64_t)idle_time.dwHighDateTime << 32) | idle_time.dwLowDateTime;
+	uint64_t kernel = ((uint64_t)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+	uint64_t user = ((uint64_t)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+	*total = kernel + user;
+	*busy = *total - idle;
+	return true;
+}
+
 void
 system_process_events(void) {
 }
@@ -559,6 +575,30 @@ system_hardware_threads(void) {
 #endif
 }
 
+bool
+system_cpu_times(uint64_t* busy, uint64_t* total) {
+#if FOUNDATION_PLATFORM_LINUX
+	FILE* stat = fopen("/proc/stat", "r");
+	if (!stat)
+		return false;
+
+	unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0;
+	int field_count = fscanf(stat, "cpu %llu %llu %llu %llu %llu %llu %llu",
+	                         &user, &nice, &system, &idle, &iowait, &irq, &softirq);
+	fclose(stat);
+	if (field_count < 4)
+		return false;
+
+	*busy = user + nice + system + irq + softirq;
+	*total = *busy + idle + iowait;
+	return true;
+#else
+	FOUNDATION_UNUSED(busy);
+	FOUNDATION_UNUSED(total);
+	return false;
+#endif
+}
+
 void
 system_process_events(void) {
 #if FOUNDATION_PLATFORM_ANDROID
@@ -58,6 +58,15 @@ system_byteorder(void);
 FOUNDATION_API size_t
 system_hardware_threads(void);
 
+/*! Get the cpu time spent by all the hardware threads since boot, and how much of it was spent
+not idling. Load over a period is given by the difference of two samples. Only available on
+Windows and Linux.
+\param busy  Receives the non-idle cpu time, in platform specific units
+\param total Receives the total cpu time, in the same units
+\return      true if successful, false if not available */
+FOUNDATION_API bool
+system_cpu_times(uint64_t* busy, uint64_t* total);
+
 /*! Get current host name of system in the given buffer
 \param buffer Buffer
 \param capacity Capacity of buffer
@@ -346,6 +346,9 @@ before function returns or scope ends) */
 #define MEMORY_ZERO_INITIALIZED (1U<<3)
 /*! Memory flag, memory content does not have to be preserved during reallocation */
 #define MEMORY_NO_PRESERVE      (1U<<4)
+/*! Memory flag, memory must come from the memory system even if a memory arena is
+active on the calling thread (for allocations outliving the arena scope) */
+#define MEMORY_NO_ARENA         (1U<<5)
 
 /*! Event flag, event is delayed and will be delivered at a later timestamp */
 #define EVENTFLAG_DELAY 1U
@@ -511,8 +514,12 @@ typedef struct hashtable64_entry_t    hashtable64_entry_t;
 typedef struct hashtable32_t          hashtable32_t;
 /*! Hash table mapping 64-bit keys to 64-bit values */
 typedef struct hashtable64_t          hashtable64_t;
+/*! Job scheduled on the worker thread pool, opaque data type */
+typedef struct job_t                  job_t;
 /*! MD5 control block */
 typedef struct md5_t                  md5_t;
+/*! Memory arena handing out memory from large blocks, freed all at once, opaque data type */
+typedef struct memory_arena_t         memory_arena_t;
 /*! Memory context holding the allocation context stack */
 typedef struct memory_context_t       memory_context_t;
 /*! Memory system declaration */
@@ -670,19 +677,27 @@ typedef void (* memory_thread_finalize_fn)(void);
 /*! Memory tracker tracking function prototype. Implementation of a memory tracker must
 provide an implementation with this prototype for tracking memory allocations
 \param p Pointer to allocated memory block
-\param size Size of memory block */
-typedef void (* memory_track_fn)(void* p, size_t size);
+\param size Size of memory block
+\param context Memory context of the allocation */
+typedef void (* memory_track_fn)(void* p, size_t size, hash_t context);
 
 /*! Memory tracker untracking function prototype. Implementation of a memory tracker must
 provide an implementation with this prototype for untracking memory allocations
-\param p Pointer to deallocated memory block */
-typedef void (* memory_untrack_fn)(void* p);
+\param p Pointer to deallocated memory block
+\return Memory context the block was tracked in, 0 if not tracked */
+typedef hash_t (* memory_untrack_fn)(void* p);
 
 /*! Memory tracker statistics function prototype. Implementation of a memory tracker must
 provide an implementation with this prototype for memory statistics
 \return Memory statistics */
 typedef memory_statistics_t (* memory_statistics_fn)(void);
 
+/*! Memory tracker context statistics function prototype. Implementation of a memory tracker
+can provide an implementation with this prototype for memory statistics of a single context
+\param context Memory context
+\return Memory statistics of the context */
+typedef memory_statistics_t (* memory_context_statistics_fn)(hash_t context);
+
 /*! Memory tracker dump function prototype. Implementation of a memory tracker can
 provide an implementation of this prototype.
 \param handler Dump handler function */
@@ -703,6 +718,16 @@ typedef void (* profile_read_fn)(void* data, size_t size);
 \return Implementation specific data which can be obtained through thread_result */
 typedef void* (* thread_fn)(void* arg);
 
+/*! Job entry point function prototype
+\param arg Argument given when the job was created */
+typedef void (* job_fn)(void* arg);
+
+/*! Parallel for body function prototype, called for a subrange of indices
+\param begin First index of the subrange
+\param end One past the last index of the subrange
+\param arg Argument passed by caller to job_parallel_for */
+typedef void (* job_range_fn)(size_t begin, size_t end, void* arg);
+
 /*! Any function to be used in conjunction with the exception handling
 in the library should have this prototype
 \param arg Implementation specific argument passed to exception_try
@@ -846,6 +871,8 @@ struct foundation_config_t {
 	size_t thread_stack_size;
 	/*! Number of random state blocks to preallocate on thread startup. Zero for default (0) */
 	size_t random_state_prealloc;
+	/*! Number of job worker threads. Zero for default (hardware threads minus one, at least one) */
+	size_t job_thread_count;
 };
 
 /*! String tuple holding string data pointer and length. This is used to avoid extra calls
@@ -938,6 +965,8 @@ struct memory_tracker_t {
 	memory_statistics_fn statistics;
 	/*! Dump */
 	memory_tracker_dump_fn dump;
+	/*! Statistics per memory context */
+	memory_context_statistics_fn context_statistics;
 	/*! Initialize memory tracker */
 	system_initialize_fn initialize;
 	/*! Abort memory tracker */
@@ -956,6 +985,10 @@ struct memory_statistics_t {
 	uint32_t allocated_total;
 	/*! Number of allocated bytes, current */
 	uint32_t allocated_current;
+	/*! Number of memory arenas, current */
+	uint32_t arenas_current;
+	/*! Number of bytes reserved in memory arena blocks, current */
+	uint32_t arena_allocated_current;
 };
 
 /*! Version identifier expressed as an 128-bit integer with major, minor,
@@ -0,0 +1,1018 @@
+#include "timelapse.h"
+#include "common.h"
+#include "scm_proxy.h"
+#include "session.h"
+#include "timing.h"
+#include "replay.h"
+#include "scoped_string.h"
+
+#include "foundation/foundation.h"
+#include "foundation/hashstrings.h"
+#include "foundation/string.h"
+#include "foundation/log.h"
+#include "foundation/time.h"
+#include "foundation/random.h"
+#include "foundation/thread.h"
+#include "foundation/system.h"
+#include "foundation/semaphore.h"
+#include "foundation/environment.h"
+#include "foundation/path.h"
+#include "foundation/stream.h"
+#include "foundation/fs.h"
+#include "foundation/lz.h"
+
+#if FOUNDATION_PLATFORM_WINDOWS
+    #include "foundation/windows.h"
+    #undef THREAD_PRIORITY_NORMAL
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#include <imgui/imgui.h>
+
+#define BENCHMARK_ARRAYSIZE(_ARR) ((size_t)(sizeof(_ARR)/sizeof(*(_ARR))))
+
+using namespace timelapse;
+
+// Synthetic data sets, each benchmark runs against all the sizes of its data set
+const size_t ANNOTATE_LINE_COUNTS[] = { 1000, 50000, 500000 };
+const size_t REVISION_COUNTS[] = { 10000, 100000 };
+const size_t SESSION_LOOKUP_COUNT = 1000;
+const int BENCHMARK_RUN_COUNT = 5;
+const size_t ALLOCATION_ROUND_COUNT = 2000000;
+const size_t ALLOCATION_LIVE_COUNT = 1024;
+
+// End-to-end fetch benchmark
+const deltatime_t FETCH_TIMEOUT = 600.0;
+const unsigned FETCH_IDLE_WAIT_MS = 100;
+
+// Scalability sweep, each axis is swept with the other one kept at its base size
+const size_t SWEEP_REVISION_COUNTS[] = { 100, 500, 1000, 5000, 20000, 50000, 100000 };
+const size_t SWEEP_LINE_COUNTS[] = { 100, 1000, 10000, 100000, 1000000 };
+const size_t SWEEP_BASE_REVISION_COUNT = 1000;
+const size_t SWEEP_BASE_LINE_COUNT = 1000;
+const int SWEEP_FRAME_COUNT = 60;
+const int HEADLESS_DISPLAY_WIDTH = 1600;
+const int HEADLESS_DISPLAY_HEIGHT = 900;
+
+struct benchmark_data_t
+{
+    string_t annotate_output{};
+    string_t revisions_log{};
+    lines_t revisions_log_lines{};
+
+    /// Compressed annotate output, and a buffer large enough to hold either it or the annotate output.
+    void* compressed{};
+    size_t compressed_size{};
+    void* buffer{};
+};
+
+/// Returns the number of operations (i.e. lines or revisions) processed.
+typedef size_t (*benchmark_fn)(const benchmark_data_t& data);
+
+static string_t generate_annotate_output(size_t line_count)
+{
+    static const char* authors[] = { "jonathan", "alex", "sam", "marie-eve" };
+    static const char* codes[] = {
+        "",
+        "}",
+        "    return 0;",
+        "    for (size_t i = 0; i < lines.count; ++i)",
+        "        array_push(cmd->results, string_clone(STRING_ARGS(output.value)));",
+        "// Give some timeslice (50ms), so we won't waste 100% cpu while waiting for the process to end."
+    };
+
+    const size_t capacity = line_count * 160;
+    string_t output = { (char*)memory_allocate(HASH_BENCHMARK, capacity, 0, 0), 0 };
+    for (size_t i = 0; i < line_count; ++i)
+    {
+        const char* author = authors[random32_range(0, (uint32_t)BENCHMARK_ARRAYSIZE(authors))];
+        const char* code = codes[random32_range(0, (uint32_t)BENCHMARK_ARRAYSIZE(codes))];
+        string_t line = string_format(output.str + output.length, capacity - output.length,
+            STRING_CONST("%10s %012x 2018-%02u-%02u: %s\n"),
+            author, random32(), random32_range(1, 13), random32_range(1, 29), code);
+        output.length += line.length;
+    }
+
+    return output;
+}
+
+static string_t generate_revisions_log(size_t revision_count)
+{
+    string_t log = { 0, 0 };
+    const size_t capacity = revision_count * 128;
+    log.str = (char*)memory_allocate(HASH_BENCHMARK, capacity, 0, 0);
+    for (size_t i = 0; i < revision_count; ++i)
+    {
+        string_t line = string_format(log.str + log.length, capacity - log.length,
+            STRING_CONST("%u|alex|%012x|%u days ago|2018-%02u-%02u 10:11 +0200|default|Fixed some more stuff around #%u\n"),
+            (unsigned)(revision_count - i), random32(), (unsigned)i, random32_range(1, 13), random32_range(1, 29), (unsigned)i);
+        log.length += line.length;
+    }
+    return log;
+}
+
+static string_t generate_patch(size_t hunk_count)
+{
+    const size_t capacity = 128 + hunk_count * 192;
+    string_t patch = { (char*)memory_allocate(HASH_BENCHMARK, capacity, 0, 0), 0 };
+    patch.length = string_copy(patch.str, capacity, STRING_CONST("diff -r 0123456789ab -r ba9876543210 session.cpp\n--- a/session.cpp\n+++ b/session.cpp\n")).length;
+    for (size_t i = 0; i < hunk_count; ++i)
+    {
+        const unsigned line = (unsigned)(i * 20 + 1);
+        string_t hunk = string_format(patch.str + patch.length, capacity - patch.length,
+            STRING_CONST("@@ -%u,4 +%u,5 @@\n     session::update();\n-    render_progress();\n+    if (session::has_pending_updates())\n+        wake_main_loop();\n     render_main_window();\n }\n"),
+            line, line);
+        patch.length += hunk.length;
+    }
+    return patch;
+}
+
+// Previous implementation, scanning the buffer once to count lines and then again to explode them.
+static lines_t legacy_split_lines(const char* str, size_t len)
+{
+    size_t occurence = 0;
+    size_t offset = 0;
+    while (true)
+    {
+        size_t foffset = string_find(str, len, STRING_NEWLINE[0], offset);
+        if (foffset == STRING_NPOS)
+            break;
+        offset = foffset + 1;
+        occurence++;
+    }
+    occurence += (offset+1 < len);
+
+    lines_t lines;
+    lines.items = (string_const_t*)memory_allocate(HASH_BENCHMARK, occurence * sizeof(string_const_t), 0, 0);
+    lines.count = string_explode(str, len, STRING_CONST(STRING_NEWLINE), lines.items, occurence, false);
+    return lines;
+}
+
+static size_t benchmark_legacy_split_lines(const benchmark_data_t& data)
+{
+    lines_t lines = legacy_split_lines(STRING_ARGS(data.annotate_output));
+    const size_t count = lines.count;
+    string_lines_finalize(lines);
+    return count;
+}
+
+static size_t benchmark_split_lines(const benchmark_data_t& data)
+{
+    lines_t lines = string_split_lines(STRING_ARGS(data.annotate_output));
+    const size_t count = lines.count;
+    string_lines_finalize(lines);
+    return count;
+}
+
+static size_t benchmark_find_all(const benchmark_data_t& data)
+{
+    generics::vector<size_t> offsets;
+    offsets.reserve(data.annotate_output.length / 32);
+    return string_find_all(STRING_ARGS(data.annotate_output), STRING_NEWLINE[0], offsets);
+}
+
+static size_t benchmark_legacy_explode_fields(const benchmark_data_t& data)
+{
+    size_t field_count = 0;
+    for (size_t i = 0; i < data.revisions_log_lines.count; ++i)
+    {
+        string_const_t infos[16];
+        field_count += string_explode(STRING_ARGS(data.revisions_log_lines.items[i]), STRING_CONST("|"), infos, BENCHMARK_ARRAYSIZE(infos), false);
+    }
+    return field_count;
+}
+
+static size_t benchmark_split_fields(const benchmark_data_t& data)
+{
+    size_t field_count = 0;
+    for (size_t i = 0; i < data.revisions_log_lines.count; ++i)
+    {
+        string_const_t infos[16];
+        field_count += string_split_fields(STRING_ARGS(data.revisions_log_lines.items[i]), '|', infos, BENCHMARK_ARRAYSIZE(infos), false);
+    }
+    return field_count;
+}
+
+static size_t benchmark_revision_list(const benchmark_data_t& data)
+{
+    memory_arena_t* arena = memory_arena_allocate(HASH_BENCHMARK, 0);
+    generics::vector<scm::revision_t> revisions;
+    {
+        scoped_arena_t scope(arena);
+        revisions = scm::revision_list(data.revisions_log_lines.items, data.revisions_log_lines.count);
+    }
+    const size_t count = revisions.size();
+    for (auto& rev : revisions)
+        scm::revision_deallocate(rev);
+    memory_arena_deallocate(arena);
+    return count;
+}
+
+static size_t benchmark_annotation_lines(const benchmark_data_t& data)
+{
+    memory_arena_t* arena = memory_arena_allocate(HASH_BENCHMARK, 0);
+    size_t count = 0;
+    {
+        scoped_arena_t scope(arena);
+        pool::line_id_t* lines = scm::annotation_lines(STRING_ARGS(data.annotate_output));
+        count = array_size(lines);
+        array_deallocate(lines);
+    }
+    memory_arena_deallocate(arena);
+    return count;
+}
+
+static size_t benchmark_lz_compress(const benchmark_data_t& data)
+{
+    const size_t capacity = lz_compress_bound(data.annotate_output.length);
+    return lz_compress(STRING_ARGS(data.annotate_output), data.buffer, capacity) > 0 ? data.annotate_output.length : 0;
+}
+
+static size_t benchmark_lz_decompress(const benchmark_data_t& data)
+{
+    return lz_decompress(data.compressed, data.compressed_size, data.buffer, data.annotate_output.length);
+}
+
+// The session benchmarks work on the revisions loaded in the session by main_run.
+static size_t benchmark_session_lookup(const benchmark_data_t& data)
+{
+    FOUNDATION_UNUSED(data);
+    const auto& revisions = session::revisions();
+    size_t found = 0;
+    for (size_t i = 0; i < SESSION_LOOKUP_COUNT; ++i)
+    {
+        const int id = revisions[random32_range(0, (uint32_t)revisions.size())].id;
+        found += session::find_revision(id) != nullptr;
+        found += session::set_current_revision(id) == id;
+        found += session::revision_cursor() >= 0;
+    }
+    return found;
+}
+
+static size_t benchmark_session_order_revisions(const benchmark_data_t& data)
+{
+    FOUNDATION_UNUSED(data);
+    const auto& revisions = session::revisions();
+    scm::request_t request = scm::order_revisions(revisions.begin(), revisions.size());
+    while (!scm::pop_completed_request())
+        thread_yield();
+
+    const size_t count = scm::revision_order(request).size();
+    scm::dispose_request(request);
+    return count;
+}
+
+static void run_benchmark(const char* name, benchmark_fn fn, const benchmark_data_t& data, size_t bytes)
+{
+    deltatime_t best = 0;
+    size_t ops = 0;
+    const memory_statistics_t stats_start = memory_statistics();
+    for (int i = 0; i < BENCHMARK_RUN_COUNT; ++i)
+    {
+        const tick_t start = time_current();
+        ops = fn(data);
+        const deltatime_t elapsed = time_elapsed(start);
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+    const memory_statistics_t stats_end = memory_statistics();
+
+    // Allocations are counted on all threads (i.e. including the job workers), averaged over the runs.
+    ops = generics::max(ops, (size_t)1);
+    const double allocations = (uint32_t)(stats_end.allocations_total - stats_start.allocations_total) / (double)BENCHMARK_RUN_COUNT;
+    const double allocated = (uint32_t)(stats_end.allocated_total - stats_start.allocated_total) / (double)BENCHMARK_RUN_COUNT;
+
+    log_infof(HASH_BENCHMARK, STRING_CONST("%-26s %8" PRIsize " ops %10.3f ms %9.2f MB/s %10.1f ns/op %9.1f B/op %8.3f allocs/op"),
+        name, ops, best * 1000.0, bytes / (1024.0 * 1024.0) / best, best * 1000000000.0 / ops, allocated / ops, allocations / ops);
+}
+
+struct allocation_benchmark_t
+{
+    const memory_system_t* system{};
+    uint32_t seed{};
+};
+
+// Allocates and frees blocks in random order, with a working set of live blocks sized like parsed revision fields and lines.
+static void* allocation_benchmark_thread(void* arg)
+{
+    const allocation_benchmark_t* benchmark = (const allocation_benchmark_t*)arg;
+    const memory_system_t& system = *benchmark->system;
+
+    void* live[ALLOCATION_LIVE_COUNT] = {};
+    uint32_t seed = benchmark->seed;
+    for (size_t i = 0; i < ALLOCATION_ROUND_COUNT; ++i)
+    {
+        seed = seed * 1664525U + 1013904223U;
+        const size_t slot = (seed >> 8) % ALLOCATION_LIVE_COUNT;
+        if (live[slot])
+        {
+            system.deallocate(live[slot]);
+            live[slot] = nullptr;
+        }
+        else
+        {
+            const size_t size = (seed & 0x1F) == 0 ? 1024 + (seed >> 20) % 8192 : 8 + (seed >> 23) % 256;
+            live[slot] = system.allocate(HASH_BENCHMARK, size, 0, 0);
+            *(char*)live[slot] = (char)i;
+        }
+    }
+
+    for (size_t i = 0; i < ALLOCATION_LIVE_COUNT; ++i)
+        system.deallocate(live[i]);
+    if (system.thread_finalize)
+        system.thread_finalize();
+    return 0;
+}
+
+// Drives the memory system directly (it does not replace the one foundation was initialized with).
+static void run_allocation_benchmark(const char* name, const memory_system_t& system, size_t thread_count)
+{
+    allocation_benchmark_t benchmarks[64];
+    thread_t* threads[64];
+    thread_count = generics::min(thread_count, BENCHMARK_ARRAYSIZE(threads));
+
+    system.initialize();
+    const tick_t start = time_current();
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        benchmarks[i].system = &system;
+        benchmarks[i].seed = random32();
+        threads[i] = thread_allocate(allocation_benchmark_thread, &benchmarks[i], STRING_CONST("allocation"), THREAD_PRIORITY_NORMAL, 0);
+        thread_start(threads[i]);
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        thread_join(threads[i]);
+        thread_deallocate(threads[i]);
+    }
+    const deltatime_t elapsed = time_elapsed(start);
+    system.finalize();
+
+    log_infof(HASH_BENCHMARK, STRING_CONST("%-24s %2" PRIsize " threads %10.3f ms %10.2f Mops/s"),
+        name, thread_count, elapsed * 1000.0, (thread_count * ALLOCATION_ROUND_COUNT) / elapsed / 1000000.0);
+}
+
+struct fetch_result_t
+{
+    deltatime_t first_revisions{ -1 };
+    deltatime_t first_annotation{ -1 };
+    deltatime_t complete{ -1 };
+    size_t revision_count{};
+    size_t annotated_count{};
+    int process_count{};
+    size_t peak_memory{};
+};
+
+static semaphore_t g_fetch_wakeup;
+
+static size_t process_peak_memory()
+{
+    #if FOUNDATION_PLATFORM_WINDOWS
+        PROCESS_MEMORY_COUNTERS counters;
+        if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return counters.PeakWorkingSetSize;
+        return 0;
+    #else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        return (size_t)usage.ru_maxrss * 1024;
+    #endif
+}
+
+static void wake_fetch_loop()
+{
+    // Invoked by the scm workers, like the application wakes up its main loop.
+    semaphore_post(&g_fetch_wakeup);
+}
+
+// Drives the session like the main loop does, without any window, until all the revisions got fetched.
+static fetch_result_t run_fetch(const char* file_path)
+{
+    fetch_result_t result;
+    const int spawned_processes = scm::stats().spawned_processes;
+
+    session::setup(file_path);
+    const tick_t start = time_current();
+    session::fetch_revisions();
+
+    while (time_elapsed(start) < FETCH_TIMEOUT)
+    {
+        session::update();
+
+        const deltatime_t elapsed = time_elapsed(start);
+        if (result.first_revisions < 0 && session::has_revisions())
+            result.first_revisions = elapsed;
+
+        const scm::revision_t* crev = session::current_revision();
+        if (result.first_annotation < 0 && crev && crev->extra_fetched)
+            result.first_annotation = elapsed;
+
+        const double update_delay = session::next_update_delay();
+        if (!session::is_fetching_revisions() && !session::is_fetching_annotations() && !session::has_pending_updates() && update_delay < 0)
+        {
+            result.complete = elapsed;
+            break;
+        }
+
+        // Like the application, sleeps until a request completes or a delayed update is due.
+        if (!session::has_pending_updates())
+            semaphore_try_wait(&g_fetch_wakeup, update_delay < 0 ? FETCH_IDLE_WAIT_MS : generics::min(FETCH_IDLE_WAIT_MS, (unsigned)(update_delay * 1000.0) + 1));
+    }
+
+    for (const auto& rev : session::revisions())
+        result.annotated_count += rev.extra_fetched ? 1 : 0;
+    result.revision_count = session::revisions().size();
+    result.process_count = scm::stats().spawned_processes - spawned_processes;
+    result.peak_memory = process_peak_memory();
+
+    session::shutdown();
+    return result;
+}
+
+static void write_fetch_result(stream_t* stream, const fetch_result_t& result, bool last)
+{
+    stream_write_format(stream, STRING_CONST(
+        "    { \"first_revisions_ms\": %.3f, \"first_annotation_ms\": %.3f, \"complete_ms\": %.3f, "
+        "\"revisions\": %" PRIsize ", \"annotated\": %" PRIsize ", \"processes\": %d, \"peak_memory\": %" PRIsize " }%s\n"),
+        result.first_revisions * 1000.0, result.first_annotation * 1000.0, result.complete * 1000.0,
+        result.revision_count, result.annotated_count, result.process_count, result.peak_memory, last ? "" : ",");
+}
+
+/// Runs the end-to-end fetch benchmark on a file, writing the results as JSON to the output file (or stdout).
+/// Times are -1 when the stage was never reached (i.e. the fetch failed or timed out).
+static int run_fetch_benchmark(const string_const_t& file, const string_const_t& output, int run_count)
+{
+    scoped_string_t file_path = path_allocate_absolute(STRING_ARGS(file));
+    if (!fs_is_file(STRING_ARGS(file_path.value)))
+    {
+        log_errorf(HASH_BENCHMARK, ERROR_INVALID_VALUE, STRING_CONST("Invalid fetch benchmark file: %.*s"), STRING_FORMAT(file));
+        return -1;
+    }
+
+    stream_t* stream = output.length ?
+        fs_open_file(STRING_ARGS(output), STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE) : stream_open_stdout();
+    if (!stream)
+    {
+        log_errorf(HASH_BENCHMARK, ERROR_ACCESS_DENIED, STRING_CONST("Unable to open fetch benchmark output: %.*s"), STRING_FORMAT(output));
+        return -1;
+    }
+
+    semaphore_initialize(&g_fetch_wakeup, 0);
+    scm::set_request_completed_handler(wake_fetch_loop);
+
+    stream_write_format(stream, STRING_CONST("{\n  \"file\": \"%s\",\n  \"runs\": [\n"), file_path.value.str);
+    for (int i = 0; i < run_count; ++i)
+    {
+        const fetch_result_t result = run_fetch(file_path.value.str);
+        log_infof(HASH_BENCHMARK, STRING_CONST("Fetch run %d: revisions %.3f ms, first annotation %.3f ms, complete %.3f ms (%" PRIsize "/%" PRIsize " revisions, %d processes)"),
+            i + 1, result.first_revisions * 1000.0, result.first_annotation * 1000.0, result.complete * 1000.0,
+            result.annotated_count, result.revision_count, result.process_count);
+        write_fetch_result(stream, result, i + 1 == run_count);
+    }
+    stream_write_format(stream, STRING_CONST("  ]\n}\n"));
+
+    scm::set_request_completed_handler(nullptr);
+    semaphore_finalize(&g_fetch_wakeup);
+    stream_deallocate(stream);
+    return 0;
+}
+
+struct sweep_result_t
+{
+    size_t revision_count{};
+    size_t line_count{};
+    deltatime_t revisions_parse{};
+    deltatime_t annotations_parse{};
+    double fetch_throughput{};
+    size_t memory{};
+    deltatime_t first_frame{};
+    deltatime_t frame{};
+    deltatime_t frame_max{};
+};
+
+static void* imgui_allocate(size_t size, void* user_data)
+{
+    FOUNDATION_UNUSED(user_data);
+    return memory_allocate(0, size, 0, MEMORY_PERSISTENT | MEMORY_NO_ARENA);
+}
+
+static void imgui_deallocate(void* ptr, void* user_data)
+{
+    FOUNDATION_UNUSED(user_data);
+    memory_deallocate(ptr);
+}
+
+/// Sets up an ImGui context like the application does, without any window nor GL device.
+/// The font atlas gets built, but never uploaded, and the draw data is dropped each frame.
+static void headless_initialize()
+{
+    ImGui::SetAllocatorFunctions(imgui_allocate, imgui_deallocate);
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.WantSaveIniSettings = false;
+    io.DisplaySize = ImVec2((float)HEADLESS_DISPLAY_WIDTH, (float)HEADLESS_DISPLAY_HEIGHT);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.MousePos = ImVec2(0.0f, 0.0f);
+
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    ImGui::StyleColorsDark();
+}
+
+static void headless_finalize()
+{
+    ImGui::DestroyContext();
+}
+
+static deltatime_t headless_render()
+{
+    const ImGuiIO& io = ImGui::GetIO();
+    const tick_t start = time_current();
+    ImGui::NewFrame();
+    timelapse::render((int)io.DisplaySize.x, (int)io.DisplaySize.y);
+    ImGui::Render();
+    const deltatime_t elapsed = time_elapsed(start);
+
+    memory_scratch_reset();
+    return elapsed;
+}
+
+static deltatime_t headless_frame(bool input = false)
+{
+    // Moving the mouse makes the frame a non steady one, which is allowed to allocate.
+    ImGuiIO& io = ImGui::GetIO();
+    io.MousePos = input ? ImVec2(io.MousePos.x + 1.0f, 0.0f) : io.MousePos;
+    return headless_render();
+}
+
+/// Loads synthetic revisions in the session, the last one being the current revision with its annotations and patch.
+/// The annotations of the other revisions never get fetched, so that the session never spawns any scm command.
+static void load_sweep_session(const lines_t& revisions_log_lines, const string_t& annotate_output, const string_t& patch = {})
+{
+    memory_arena_t* arena = memory_arena_allocate(HASH_BENCHMARK, 0);
+    generics::vector<scm::revision_t> revisions;
+    {
+        scoped_arena_t scope(arena);
+        revisions = scm::revision_list(revisions_log_lines.items, revisions_log_lines.count);
+    }
+    session::load_revisions(revisions, arena, false);
+
+    scm::revision_t* crev = session::find_revision(session::revisions().back().id);
+    session::set_current_revision(crev->id);
+
+    // Like a fetched revision, the line ids are owned by the revision arena and the lines by the pool.
+    crev->arena = memory_arena_allocate(HASH_BENCHMARK, 0);
+    {
+        scoped_arena_t scope(crev->arena);
+        crev->annotations = scm::annotation_lines(STRING_ARGS(annotate_output));
+        crev->patch = string_clone(STRING_ARGS(patch));
+    }
+    crev->extra_fetched = true;
+}
+
+static sweep_result_t run_sweep_point(size_t revision_count, size_t line_count)
+{
+    sweep_result_t result;
+    result.revision_count = revision_count;
+    result.line_count = line_count;
+
+    string_t revisions_log = generate_revisions_log(revision_count);
+    string_t annotate_output = generate_annotate_output(line_count);
+
+    benchmark_data_t data;
+    data.revisions_log = revisions_log;
+    data.annotate_output = annotate_output;
+    tick_t start = time_current();
+    data.revisions_log_lines = string_split_lines(STRING_ARGS(revisions_log));
+    benchmark_revision_list(data);
+    result.revisions_parse = time_elapsed(start);
+
+    start = time_current();
+    benchmark_annotation_lines(data);
+    result.annotations_parse = time_elapsed(start);
+
+    // Fetch throughput is the rate at which scm outputs become session data, once hg is done with them.
+    const size_t memory_start = memory_statistics().allocated_current;
+    start = time_current();
+    load_sweep_session(data.revisions_log_lines, annotate_output);
+    const deltatime_t load_time = time_elapsed(start);
+    result.memory = memory_statistics().allocated_current - memory_start;
+    result.fetch_throughput = (revisions_log.length + annotate_output.length) / (result.revisions_parse + load_time) / (1024.0 * 1024.0);
+
+    // The data got loaded outside of any frame, like the user had just picked the file.
+    result.first_frame = headless_frame(true);
+    for (int i = 0; i < SWEEP_FRAME_COUNT; ++i)
+    {
+        const deltatime_t elapsed = headless_frame();
+        result.frame += elapsed / SWEEP_FRAME_COUNT;
+        result.frame_max = generics::max(result.frame_max, elapsed);
+    }
+
+    timelapse::shutdown();
+
+    string_lines_finalize(data.revisions_log_lines);
+    string_deallocate(annotate_output.str);
+    string_deallocate(revisions_log.str);
+    return result;
+}
+
+static void write_sweep_result(stream_t* stream, const sweep_result_t& result, bool json, bool last)
+{
+    if (json)
+    {
+        stream_write_format(stream, STRING_CONST(
+            "    { \"revisions\": %" PRIsize ", \"lines\": %" PRIsize ", \"revisions_parse_ms\": %.3f, \"annotations_parse_ms\": %.3f, "
+            "\"fetch_mb_s\": %.2f, \"memory\": %" PRIsize ", \"first_frame_ms\": %.3f, \"frame_ms\": %.3f, \"frame_max_ms\": %.3f }%s\n"),
+            result.revision_count, result.line_count, result.revisions_parse * 1000.0, result.annotations_parse * 1000.0,
+            result.fetch_throughput, result.memory, result.first_frame * 1000.0, result.frame * 1000.0, result.frame_max * 1000.0, last ? "" : ",");
+    }
+    else
+    {
+        stream_write_format(stream, STRING_CONST("%" PRIsize ",%" PRIsize ",%.3f,%.3f,%.2f,%" PRIsize ",%.3f,%.3f,%.3f\n"),
+            result.revision_count, result.line_count, result.revisions_parse * 1000.0, result.annotations_parse * 1000.0,
+            result.fetch_throughput, result.memory, result.first_frame * 1000.0, result.frame * 1000.0, result.frame_max * 1000.0);
+    }
+}
+
+/// Sweeps the revision count and the file length over synthetic data, writing a CSV curve to the output
+/// file (or stdout), or a JSON one if the output file has the .json extension.
+static int run_sweep_benchmark(const string_const_t& output)
+{
+    stream_t* stream = output.length ?
+        fs_open_file(STRING_ARGS(output), STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE) : stream_open_stdout();
+    if (!stream)
+    {
+        log_errorf(HASH_BENCHMARK, ERROR_ACCESS_DENIED, STRING_CONST("Unable to open sweep benchmark output: %.*s"), STRING_FORMAT(output));
+        return -1;
+    }
+
+    const string_const_t extension = path_file_extension(STRING_ARGS(output));
+    const bool json = string_equal_nocase(STRING_ARGS(extension), STRING_CONST("json"));
+    if (json)
+        stream_write_format(stream, STRING_CONST("{\n  \"points\": [\n"));
+    else
+        stream_write_format(stream, STRING_CONST("revisions,lines,revisions_parse_ms,annotations_parse_ms,fetch_mb_s,memory,first_frame_ms,frame_ms,frame_max_ms\n"));
+
+    headless_initialize();
+
+    const size_t point_count = BENCHMARK_ARRAYSIZE(SWEEP_REVISION_COUNTS) + BENCHMARK_ARRAYSIZE(SWEEP_LINE_COUNTS);
+    size_t point = 0;
+    for (size_t revision_count : SWEEP_REVISION_COUNTS)
+        write_sweep_result(stream, run_sweep_point(revision_count, SWEEP_BASE_LINE_COUNT), json, ++point == point_count);
+    for (size_t line_count : SWEEP_LINE_COUNTS)
+        write_sweep_result(stream, run_sweep_point(SWEEP_BASE_REVISION_COUNT, line_count), json, ++point == point_count);
+
+    headless_finalize();
+
+    if (json)
+        stream_write_format(stream, STRING_CONST("  ]\n}\n"));
+    stream_deallocate(stream);
+    return 0;
+}
+
+struct render_case_t
+{
+    const char* name;
+    size_t revision_count;
+    size_t line_count;
+    size_t hunk_count;
+};
+
+// Views rendered by the render benchmark, the patch view is only shown when the current revision has a patch
+const render_case_t RENDER_CASES[] = {
+    { "annotations", 1000, 1000, 0 },
+    { "long_history", 100000, 1000, 0 },
+    { "long_file", 1000, 100000, 0 },
+    { "patch", 1000, 10000, 2000 }
+};
+const int RENDER_FRAME_COUNT = 300;
+
+struct render_result_t
+{
+    deltatime_t first_frame{};
+    deltatime_t frame{};
+    deltatime_t frame_max{};
+    deltatime_t change_list{};
+    deltatime_t annotations_view{};
+    deltatime_t patch_view{};
+    size_t vertex_count{};
+    size_t index_count{};
+    double allocations{};
+};
+
+static deltatime_t section_seconds(timing::section_t section)
+{
+    return time_ticks_to_seconds(timing::section_time(section));
+}
+
+/// Renders the views over synthetic session data for a number of frames, timing each view through the
+/// frame sections (see timing.h). The draw list sizes are the ones of the last frame, and the allocation counts
+/// include the ImGui ones.
+static render_result_t run_render_case(const render_case_t& render_case, int frame_count)
+{
+    render_result_t result;
+
+    string_t revisions_log = generate_revisions_log(render_case.revision_count);
+    lines_t revisions_log_lines = string_split_lines(STRING_ARGS(revisions_log));
+    string_t annotate_output = generate_annotate_output(render_case.line_count);
+    string_t patch = generate_patch(render_case.hunk_count);
+
+    load_sweep_session(revisions_log_lines, annotate_output, patch);
+    timelapse::show_patch_view(render_case.hunk_count > 0);
+    result.first_frame = headless_frame(true);
+
+    for (int i = 0; i < frame_count; ++i)
+    {
+        timing::begin_frame();
+        const memory_statistics_t stats_start = memory_statistics();
+        const deltatime_t elapsed = headless_render();
+        const memory_statistics_t stats_end = memory_statistics();
+        result.allocations += (uint32_t)(stats_end.allocations_total - stats_start.allocations_total) / (double)frame_count;
+
+        result.frame += elapsed / frame_count;
+        result.frame_max = generics::max(result.frame_max, elapsed);
+        result.change_list += section_seconds(timing::section_t::render_change_list) / frame_count;
+        result.annotations_view += section_seconds(timing::section_t::render_annotations_view) / frame_count;
+        result.patch_view += section_seconds(timing::section_t::render_patch_view) / frame_count;
+        timing::end_frame();
+    }
+
+    const ImDrawData* draw_data = ImGui::GetDrawData();
+    result.vertex_count = draw_data ? (size_t)draw_data->TotalVtxCount : 0;
+    result.index_count = draw_data ? (size_t)draw_data->TotalIdxCount : 0;
+
+    timelapse::show_patch_view(false);
+    timelapse::shutdown();
+
+    string_deallocate(patch.str);
+    string_deallocate(annotate_output.str);
+    string_lines_finalize(revisions_log_lines);
+    string_deallocate(revisions_log.str);
+    return result;
+}
+
+/// Runs the render benchmark at a fixed display size without any window nor GL device, writing the
+/// results as JSON to the output file (or stdout).
+static int run_render_benchmark(const string_const_t& output, int frame_count)
+{
+    stream_t* stream = output.length ?
+        fs_open_file(STRING_ARGS(output), STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE) : stream_open_stdout();
+    if (!stream)
+    {
+        log_errorf(HASH_BENCHMARK, ERROR_ACCESS_DENIED, STRING_CONST("Unable to open render benchmark output: %.*s"), STRING_FORMAT(output));
+        return -1;
+    }
+
+    headless_initialize();
+
+    stream_write_format(stream, STRING_CONST("{\n  \"display\": [%d, %d],\n  \"frames\": %d,\n  \"cases\": [\n"),
+        HEADLESS_DISPLAY_WIDTH, HEADLESS_DISPLAY_HEIGHT, frame_count);
+    for (size_t i = 0, end = BENCHMARK_ARRAYSIZE(RENDER_CASES); i < end; ++i)
+    {
+        const render_case_t& render_case = RENDER_CASES[i];
+        const render_result_t result = run_render_case(render_case, frame_count);
+        log_infof(HASH_BENCHMARK, STRING_CONST("%-16s frame %8.3f ms (max %8.3f ms), change list %8.3f ms, annotations %8.3f ms, patch %8.3f ms, %6" PRIsize " vertices, %.1f allocations"),
+            render_case.name, result.frame * 1000.0, result.frame_max * 1000.0, result.change_list * 1000.0,
+            result.annotations_view * 1000.0, result.patch_view * 1000.0, result.vertex_count, result.allocations);
+
+        stream_write_format(stream, STRING_CONST(
+            "    { \"name\": \"%s\", \"revisions\": %" PRIsize ", \"lines\": %" PRIsize ", \"hunks\": %" PRIsize ", "
+            "\"first_frame_ms\": %.3f, \"frame_ms\": %.3f, \"frame_max_ms\": %.3f, \"change_list_ms\": %.3f, "
+            "\"annotations_view_ms\": %.3f, \"patch_view_ms\": %.3f, \"vertices\": %" PRIsize ", \"indices\": %" PRIsize ", "
+            "\"allocations\": %.2f }%s\n"),
+            render_case.name, render_case.revision_count, render_case.line_count, render_case.hunk_count,
+            result.first_frame * 1000.0, result.frame * 1000.0, result.frame_max * 1000.0, result.change_list * 1000.0,
+            result.annotations_view * 1000.0, result.patch_view * 1000.0, result.vertex_count, result.index_count,
+            result.allocations, i + 1 == end ? "" : ",");
+    }
+    stream_write_format(stream, STRING_CONST("  ]\n}\n"));
+
+    headless_finalize();
+    stream_deallocate(stream);
+    return 0;
+}
+
+struct replay_result_t
+{
+    size_t frame_count{};
+    deltatime_t duration{};
+    deltatime_t frame{};
+    deltatime_t frame_max{};
+    size_t slow_frame_count{};
+    replay::stats_t stats{};
+};
+
+// Frames over that time would have dropped below 60 fps in the recorded session
+const deltatime_t REPLAY_SLOW_FRAME_TIME = 1.0 / 60.0;
+
+/// Replays a session recorded by the application (timelapse --record <file>) without any window nor
+/// repository. The scm commands complete with their recorded outputs and durations, and each frame
+/// gets rendered with its recorded input at its recorded time, writing the frame times as JSON to the
+/// output file (or stdout).
+static int run_replay_benchmark(const string_const_t& trace, const string_const_t& output)
+{
+    stream_t* stream = output.length ?
+        fs_open_file(STRING_ARGS(output), STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE) : stream_open_stdout();
+    if (!stream)
+    {
+        log_errorf(HASH_BENCHMARK, ERROR_ACCESS_DENIED, STRING_CONST("Unable to open replay benchmark output: %.*s"), STRING_FORMAT(output));
+        return -1;
+    }
+
+    headless_initialize();
+    if (!replay::start_replay(STRING_ARGS(trace)))
+    {
+        headless_finalize();
+        stream_deallocate(stream);
+        return -1;
+    }
+
+    replay_result_t result;
+    const tick_t start = time_current();
+    while (replay::next_frame())
+    {
+        const deltatime_t elapsed = headless_render();
+        result.frame_count++;
+        result.frame += elapsed;
+        result.frame_max = generics::max(result.frame_max, elapsed);
+        result.slow_frame_count += elapsed > REPLAY_SLOW_FRAME_TIME ? 1 : 0;
+    }
+    result.duration = time_elapsed(start);
+    result.frame = result.frame_count > 0 ? result.frame / result.frame_count : 0;
+    result.stats = replay::stats();
+
+    // Also stops the replay, once the pending scm requests are disposed.
+    timelapse::shutdown();
+    headless_finalize();
+
+    log_infof(HASH_BENCHMARK, STRING_CONST("Replayed %" PRIsize " frames in %.3f s: frame %.3f ms (max %.3f ms, %" PRIsize " slow), %" PRIsize "/%" PRIsize " commands (%" PRIsize " missing)"),
+        result.frame_count, result.duration, result.frame * 1000.0, result.frame_max * 1000.0, result.slow_frame_count,
+        result.stats.replayed_commands, result.stats.command_count, result.stats.missing_commands);
+
+    stream_write_format(stream, STRING_CONST(
+        "{\n  \"trace\": \"%.*s\",\n  \"frames\": %" PRIsize ",\n  \"duration_ms\": %.3f,\n  \"frame_ms\": %.3f,\n  \"frame_max_ms\": %.3f,\n"
+        "  \"slow_frames\": %" PRIsize ",\n  \"commands\": %" PRIsize ",\n  \"replayed_commands\": %" PRIsize ",\n  \"missing_commands\": %" PRIsize "\n}\n"),
+        STRING_FORMAT(trace), result.frame_count, result.duration * 1000.0, result.frame * 1000.0, result.frame_max * 1000.0,
+        result.slow_frame_count, result.stats.command_count, result.stats.replayed_commands, result.stats.missing_commands);
+    stream_deallocate(stream);
+    return 0;
+}
+
+extern int main_initialize()
+{
+    application_t application;
+    foundation_config_t config;
+    memset(&config, 0, sizeof config);
+    memset(&application, 0, sizeof application);
+
+    application.name = string_const(STRING_CONST("benchmark"));
+    application.short_name = string_const(STRING_CONST("benchmark"));
+    application.flags = APPLICATION_UTILITY;
+
+    // Same setup as the application, the tracker also provides the allocation counts
+    memory_set_tracker(memory_tracker_local());
+    static const char* const stdout_modes[] = { "--fetch", "--sweep", "--replay", "--render" };
+    const int init_result = initialize_foundation(memory_system_thread_cache(), application, config, stdout_modes, BENCHMARK_ARRAYSIZE(stdout_modes));
+    if (init_result == 0)
+        pool::initialize();
+    return init_result;
+}
+
+static void run_annotate_benchmarks(size_t line_count)
+{
+    benchmark_data_t data;
+    data.annotate_output = generate_annotate_output(line_count);
+    log_infof(HASH_BENCHMARK, STRING_CONST("Annotate output: %" PRIsize " lines, %" PRIsize " bytes"),
+        line_count, data.annotate_output.length);
+
+    run_benchmark("legacy_split_lines", benchmark_legacy_split_lines, data, data.annotate_output.length);
+    run_benchmark("string_split_lines", benchmark_split_lines, data, data.annotate_output.length);
+    run_benchmark("string_find_all", benchmark_find_all, data, data.annotate_output.length);
+    run_benchmark("annotation_lines", benchmark_annotation_lines, data, data.annotate_output.length);
+
+    // Ops are bytes for the codec.
+    const size_t capacity = lz_compress_bound(data.annotate_output.length);
+    data.compressed = memory_allocate(HASH_BENCHMARK, capacity, 0, 0);
+    data.buffer = memory_allocate(HASH_BENCHMARK, capacity, 0, 0);
+    data.compressed_size = lz_compress(STRING_ARGS(data.annotate_output), data.compressed, capacity);
+    log_infof(HASH_BENCHMARK, STRING_CONST("Compressed annotate output: %" PRIsize " bytes (%.1f%%)"),
+        data.compressed_size, data.compressed_size * 100.0 / generics::max(data.annotate_output.length, (size_t)1));
+    run_benchmark("lz_compress", benchmark_lz_compress, data, data.annotate_output.length);
+    run_benchmark("lz_decompress", benchmark_lz_decompress, data, data.annotate_output.length);
+    memory_deallocate(data.compressed);
+    memory_deallocate(data.buffer);
+
+    string_deallocate(data.annotate_output.str);
+}
+
+static void run_revisions_benchmarks(size_t revision_count)
+{
+    benchmark_data_t data;
+    data.revisions_log = generate_revisions_log(revision_count);
+    data.revisions_log_lines = string_split_lines(STRING_ARGS(data.revisions_log));
+    log_infof(HASH_BENCHMARK, STRING_CONST("Revisions log: %" PRIsize " revisions, %" PRIsize " bytes"),
+        revision_count, data.revisions_log.length);
+
+    run_benchmark("legacy_explode_fields", benchmark_legacy_explode_fields, data, data.revisions_log.length);
+    run_benchmark("string_split_fields", benchmark_split_fields, data, data.revisions_log.length);
+    run_benchmark("revision_list", benchmark_revision_list, data, data.revisions_log.length);
+
+    memory_arena_t* arena = memory_arena_allocate(HASH_BENCHMARK, 0);
+    generics::vector<scm::revision_t> revisions;
+    {
+        scoped_arena_t scope(arena);
+        revisions = scm::revision_list(data.revisions_log_lines.items, data.revisions_log_lines.count);
+    }
+    session::load_revisions(revisions, arena, false);
+
+    run_benchmark("session_lookup", benchmark_session_lookup, data, 0);
+    run_benchmark("session_order_revisions", benchmark_session_order_revisions, data, 0);
+
+    session::shutdown();
+    string_lines_finalize(data.revisions_log_lines);
+    string_deallocate(data.revisions_log.str);
+}
+
+extern int main_run(void*)
+{
+    // benchmark --fetch <file> [--hg <executable>] [--runs <count>] [--output <file.json>]
+    // benchmark --sweep [--output <file.csv|file.json>]
+    // benchmark --replay <trace> [--output <file.json>]
+    // benchmark --render [--frames <count>] [--output <file.json>]
+    string_const_t fetch_file = string_null(), replay_trace = string_null(), output = string_null();
+    int run_count = 1, frame_count = RENDER_FRAME_COUNT;
+    bool sweep = false, render = false;
+    const string_const_t* cmdline = environment_command_line();
+    for (size_t i = 1, end = array_size(cmdline); i < end; ++i)
+    {
+        const string_const_t& arg = cmdline[i];
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--sweep")))
+        {
+            sweep = true;
+            continue;
+        }
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--render")))
+        {
+            render = true;
+            continue;
+        }
+
+        if (i + 1 >= end)
+            break;
+        const string_const_t& value = cmdline[i + 1];
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--fetch")))
+            fetch_file = value;
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--replay")))
+            replay_trace = value;
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--hg")))
+            scm::set_executable(STRING_ARGS(value));
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--runs")))
+            run_count = generics::max(1, (int)string_to_int(STRING_ARGS(value)));
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--frames")))
+            frame_count = generics::max(1, (int)string_to_int(STRING_ARGS(value)));
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--output")))
+            output = value;
+        else
+            continue;
+        ++i;
+    }
+
+    if (fetch_file.length)
+        return run_fetch_benchmark(fetch_file, output, run_count);
+    if (sweep)
+        return run_sweep_benchmark(output);
+    if (replay_trace.length)
+        return run_replay_benchmark(replay_trace, output);
+    if (render)
+        return run_render_benchmark(output, frame_count);
+
+    // The splits measured here are checked against string_explode by the tests project.
+    for (size_t line_count : ANNOTATE_LINE_COUNTS)
+        run_annotate_benchmarks(line_count);
+    for (size_t revision_count : REVISION_COUNTS)
+        run_revisions_benchmarks(revision_count);
+
+    const memory_system_t malloc_system = memory_system_malloc();
+    const memory_system_t thread_cache_system = memory_system_thread_cache();
+    for (size_t thread_count = 1, max_thread_count = system_hardware_threads(); ; thread_count *= 2)
+    {
+        thread_count = generics::min(thread_count, max_thread_count);
+        run_allocation_benchmark("malloc_system", malloc_system, thread_count);
+        run_allocation_benchmark("thread_cache_system", thread_cache_system, thread_count);
+        if (thread_count == max_thread_count)
+            break;
+    }
+
+    return 0;
+}
+
+extern void main_finalize()
+{
+    pool::finalize();
+    foundation_finalize();
+}
@@ -1,4 +1,8 @@
 #include "resource.h"
+#include "timing.h"
+#include "headless.h"
+#include "pool.h"
+#include "common.h"
 
 #include <imgui/imgui.h>
 #include <foundation/foundation.h>
@@ -22,6 +26,7 @@ extern int app_initialize(GLFWwindow* window);
 extern void app_render(int display_w, int display_h);
 extern void app_shutdown();
 extern const char* app_title();
+extern double app_update_delay();
 
 // GLFW data
 HWND g_WindowHandle = nullptr;
@@ -29,6 +34,13 @@ GLFWwindow*  g_Window = nullptr;
 static double       g_Time = 0.0;
 static bool         g_MouseJustPressed[3] = { false, false, false };
 static GLFWcursor*  g_MouseCursors[ImGuiMouseCursor_COUNT] = { nullptr };
+static bool         g_Headless = false;     // Exporting the files given on the command line, without any window
+
+// Idle loop data
+static const int    ACTIVE_FRAME_COUNT = 3;     // Frames rendered after any event before going back to sleep
+static const double IDLE_WAIT_TIMEOUT = 1.0;    // Maximum time in seconds the main loop sleeps waiting for events
+static const double MIN_WAIT_TIMEOUT = 0.001;   // Waiting for events needs a positive timeout, even for an update already due
+static int          g_ActiveFrames = ACTIVE_FRAME_COUNT;
 
 // OpenGL3 data
 static char         g_GlslVersion[32] = "#version 150";
@@ -166,14 +178,21 @@ static void imgui_impl_glfw_gl3_set_clipboard_text(void* user_data, const char*
     glfwSetClipboardString((GLFWwindow*)user_data, text);
 }
 
+static void main_mark_active()
+{
+    g_ActiveFrames = ACTIVE_FRAME_COUNT;
+}
+
 static void imgui_impl_glfw_mouse_button_callback(GLFWwindow*, int button, int action, int /*mods*/)
 {
+    main_mark_active();
     if (action == GLFW_PRESS && button >= 0 && button < 3)
         g_MouseJustPressed[button] = true;
 }
 
 static void imgui_impl_glfw_scroll_callback(GLFWwindow*, double xoffset, double yoffset)
 {
+    main_mark_active();
     ImGuiIO& io = ImGui::GetIO();
     io.MouseWheelH += (float)xoffset;
     io.MouseWheel += (float)yoffset;
@@ -181,6 +200,7 @@ static void imgui_impl_glfw_scroll_callback(GLFWwindow*, double xoffset, double
 
 static void imgui_impl_glfw_key_callback(GLFWwindow*, int key, int, int action, int mods)
 {
+    main_mark_active();
     ImGuiIO& io = ImGui::GetIO();
     if (action == GLFW_PRESS)
         io.KeysDown[key] = true;
@@ -196,11 +216,32 @@ static void imgui_impl_glfw_key_callback(GLFWwindow*, int key, int, int action,
 
 static void imgui_impl_glfw_char_callback(GLFWwindow*, unsigned int c)
 {
+    main_mark_active();
     ImGuiIO& io = ImGui::GetIO();
     if (c > 0 && c < 0x10000)
         io.AddInputCharacter((unsigned short)c);
 }
 
+static void imgui_impl_glfw_cursor_pos_callback(GLFWwindow*, double, double)
+{
+    main_mark_active();
+}
+
+static void imgui_impl_glfw_window_callback(GLFWwindow*, int, int)
+{
+    main_mark_active();
+}
+
+static void imgui_impl_glfw_window_refresh_callback(GLFWwindow*)
+{
+    main_mark_active();
+}
+
+static void imgui_impl_glfw_window_focus_callback(GLFWwindow*, int)
+{
+    main_mark_active();
+}
+
 static bool imgui_impl_glfw_gl3_create_fonts_texture()
 {
     // Build texture atlas
@@ -323,6 +364,11 @@ static void imgui_impl_glfw_install_callbacks(GLFWwindow* window)
     glfwSetScrollCallback(window, imgui_impl_glfw_scroll_callback);
     glfwSetKeyCallback(window, imgui_impl_glfw_key_callback);
     glfwSetCharCallback(window, imgui_impl_glfw_char_callback);
+    glfwSetCursorPosCallback(window, imgui_impl_glfw_cursor_pos_callback);
+    glfwSetWindowSizeCallback(window, imgui_impl_glfw_window_callback);
+    glfwSetWindowPosCallback(window, imgui_impl_glfw_window_callback);
+    glfwSetWindowRefreshCallback(window, imgui_impl_glfw_window_refresh_callback);
+    glfwSetWindowFocusCallback(window, imgui_impl_glfw_window_focus_callback);
 }
 
 static bool imgui_impl_glfw_gl3_init(GLFWwindow* window, bool install_callbacks, const char* glsl_version = nullptr)
@@ -501,10 +547,23 @@ static void imgui_impl_glfw_gl3_new_frame()
     ImGui::NewFrame();
 }
 
+static void* imgui_allocate(size_t size, void* user_data)
+{
+    FOUNDATION_UNUSED(user_data);
+    return memory_allocate(0, size, 0, MEMORY_PERSISTENT | MEMORY_NO_ARENA);
+}
+
+static void imgui_deallocate(void* ptr, void* user_data)
+{
+    FOUNDATION_UNUSED(user_data);
+    memory_deallocate(ptr);
+}
+
 static void setup_imgui(GLFWwindow* window)
 {
-    // Setup Dear ImGui binding
+    // Setup Dear ImGui binding, allocating through foundation so that frame allocations are accounted for
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(imgui_allocate, imgui_deallocate);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.WantSaveIniSettings = false;
@@ -633,10 +692,19 @@ extern int main_initialize()
 
     app_configure(config, application);
 
-    int init_result = foundation_initialize(memory_system_malloc(), application, config);
+    // Scm workers and the UI thread allocate concurrently, use the thread caching allocator
+    // Headless exports without --output write their lines to stdout
+    static const char* const stdout_modes[] = { "--headless" };
+    int init_result = initialize_foundation(memory_system_thread_cache(), application, config, stdout_modes, sizeof(stdout_modes) / sizeof(stdout_modes[0]));
     if (init_result)
         return init_result;
 
+    timelapse::pool::initialize();
+
+    g_Headless = timelapse::headless::is_requested();
+    if (g_Headless)
+        return 0;
+
     GLFWwindow* window = setup_main_window();
     if (!window)
     {
@@ -653,6 +721,10 @@ extern int main_initialize()
 extern int main_run(void*)
 {
     const ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+    uint64_t frame_counter = 0;
+
+    if (g_Headless)
+        return timelapse::headless::run();
 
     while (!glfwWindowShouldClose(g_Window))
     {
@@ -660,7 +732,22 @@ extern int main_run(void*)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        if (g_ActiveFrames > 0)
+        {
+            g_ActiveFrames--;
+            glfwPollEvents();
+        }
+        else
+        {
+            // Nothing happened for a few frames, sleep until we get some input, until a background
+            // request completes and posts an empty event to wake us up, or until a delayed update is due.
+            const double update_delay = app_update_delay();
+            glfwWaitEventsTimeout(update_delay < 0.0 ? IDLE_WAIT_TIMEOUT :
+                generics::max(MIN_WAIT_TIMEOUT, generics::min(update_delay, IDLE_WAIT_TIMEOUT)));
+            g_ActiveFrames = ACTIVE_FRAME_COUNT - 1;
+        }
+
+        timelapse::timing::begin_frame();
         imgui_impl_glfw_gl3_new_frame();
 
         int display_w, display_h;
@@ -672,9 +759,17 @@ extern int main_run(void*)
         glViewport(0, 0, display_w, display_h);
         glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
         glClear(GL_COLOR_BUFFER_BIT);
-        ImGui::Render();
-        imgui_impl_glfw_gl3_render_draw_data(ImGui::GetDrawData());
+        {
+            TIMING_SCOPE(gl_submit, "imgui render");
+            ImGui::Render();
+            imgui_impl_glfw_gl3_render_draw_data(ImGui::GetDrawData());
+        }
+        timelapse::timing::end_frame();
         glfwSwapBuffers(g_Window);
+        profile_end_frame(frame_counter++);
+
+        // Scratch memory only lives for the frame
+        memory_scratch_reset();
     }
 
     return 0;
@@ -682,6 +777,13 @@ extern int main_run(void*)
 
 extern void main_finalize()
 {
+    if (g_Headless)
+    {
+        timelapse::pool::finalize();
+        foundation_finalize();
+        return;
+    }
+
     app_shutdown();
 
     imgui_impl_glfw_gl3_shutdown();
@@ -692,5 +794,6 @@ extern void main_finalize()
 
     glfwTerminate();
 
+    timelapse::pool::finalize();
     foundation_finalize();
 }
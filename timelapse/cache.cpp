@@ -0,0 +1,234 @@
+#include "cache.h"
+
+#include "foundation/environment.h"
+#include "foundation/path.h"
+#include "foundation/fs.h"
+#include "foundation/stream.h"
+#include "foundation/hash.h"
+#include "foundation/random.h"
+#include "foundation/string.h"
+#include "foundation/log.h"
+#include "foundation/hashstrings.h"
+#include "foundation/atomic.h"
+#include "foundation/array.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace cache {
+
+// Bumped whenever the entry layout changes, older entries simply stop being found.
+const char ENTRY_EXTENSION[] = ".scm1";
+
+// Past that size, the entries used the least recently get removed until the cache is back to 3/4 of it.
+const size_t SIZE_LIMIT = 512 * 1024 * 1024;
+
+static char g_directory[BUILD_MAX_PATHLEN] = {};
+static size_t g_directory_length = 0;
+
+static atomic32_t g_hits;
+static atomic32_t g_misses;
+static atomic32_t g_writes;
+
+// Size of the entries, as of the last trim plus what got written since.
+static atomic64_t g_size;
+static atomic32_t g_trimming;
+
+struct entry_file_t
+{
+    string_t path;
+    tick_t last_used;
+    size_t size;
+};
+
+/// Entries start with the working directory and the arguments of the command, each on their own
+/// line, so a hash collision never returns the output of another command.
+static string_t entry_header(const char* working_dir, const char* arguments, size_t length)
+{
+    return string_allocate_format(STRING_CONST("%s\n%.*s\n"), working_dir ? working_dir : "", (int)length, arguments);
+}
+
+static string_t entry_path(const string_t& header)
+{
+    char name[32];
+    const string_t hash_string = string_from_uint(STRING_CONST(name), hash(STRING_ARGS(header)), true, 16, '0');
+    return string_allocate_format(STRING_CONST("%.*s/%.*s%s"), (int)g_directory_length, g_directory, STRING_FORMAT(hash_string), ENTRY_EXTENSION);
+}
+
+static bool entry_file_compare(const entry_file_t& a, const entry_file_t& b)
+{
+    return a.last_used < b.last_used;
+}
+
+/// Removes the entries used the least recently (read hits touch their entry) until the cache fits in 3/4 of its
+/// size limit, which leaves room for a while before trimming again. Returns the size of the remaining entries.
+static size_t trim(size_t size_limit)
+{
+    PROFILE_SCOPE("cache trim");
+    generics::vector<entry_file_t> entries;
+    size_t size = 0;
+    string_t* names = fs_files(g_directory, g_directory_length);
+    for (unsigned i = 0, end = array_size(names); i < end; ++i)
+    {
+        if (!string_ends_with(STRING_ARGS(names[i]), STRING_CONST(ENTRY_EXTENSION)))
+            continue;
+
+        entry_file_t entry;
+        entry.path = path_allocate_concat(g_directory, g_directory_length, STRING_ARGS(names[i]));
+        entry.last_used = fs_last_modified(STRING_ARGS(entry.path));
+        entry.size = fs_size(STRING_ARGS(entry.path));
+        size += entry.size;
+        entries.push_back(entry);
+    }
+    string_array_deallocate(names);
+
+    if (size > size_limit)
+    {
+        std::sort(entries.begin(), entries.end(), entry_file_compare);
+        const size_t target = size_limit / 4 * 3;
+        size_t removed = 0;
+        for (size_t i = 0; i < entries.size() && size > target; ++i)
+        {
+            // Another session might have removed it already.
+            fs_remove_file(STRING_ARGS(entries[i].path));
+            size -= entries[i].size;
+            removed++;
+        }
+        log_debugf(HASH_TIMELAPSE, STRING_CONST("Removed %" PRIsize " scm cache entries, %" PRIsize " KB left"), removed, size / 1024);
+    }
+
+    for (auto& entry : entries)
+        string_deallocate(entry.path.str);
+    return size;
+}
+
+bool initialize()
+{
+    // The application directory is per user (i.e. %LOCALAPPDATA%\<company>\timelapse or ~/.<company>/.timelapse),
+    // with the per user temporary directory as a fallback if it cannot be written to.
+    const string_const_t base_directories[] = { environment_application_directory(), environment_temporary_directory() };
+    string_t directory = {};
+    for (const auto& base_directory : base_directories)
+    {
+        directory = path_concat(STRING_CONST(g_directory), STRING_ARGS(base_directory), STRING_CONST("cache"));
+        if (fs_make_directory(STRING_ARGS(directory)))
+            break;
+
+        log_warnf(HASH_TIMELAPSE, WARNING_RESOURCE, STRING_CONST("Unable to create the scm cache directory %.*s"), STRING_FORMAT(directory));
+        directory.length = 0;
+    }
+
+    g_directory_length = directory.length;
+    if (g_directory_length == 0)
+        return false;
+
+    atomic_store32(&g_hits, 0, memory_order_relaxed);
+    atomic_store32(&g_misses, 0, memory_order_relaxed);
+    atomic_store32(&g_writes, 0, memory_order_relaxed);
+    atomic_store32(&g_trimming, 0, memory_order_relaxed);
+    atomic_store64(&g_size, (int64_t)trim(SIZE_LIMIT), memory_order_relaxed);
+    return true;
+}
+
+void finalize()
+{
+    g_directory_length = 0;
+}
+
+bool is_enabled()
+{
+    return g_directory_length > 0;
+}
+
+bool read(const char* working_dir, const char* arguments, size_t length, string_t& output)
+{
+    if (!is_enabled())
+        return false;
+
+    PROFILE_SCOPE("cache read");
+    string_t header = entry_header(working_dir, arguments, length);
+    string_t path = entry_path(header);
+
+    bool found = false;
+    stream_t* stream = fs_is_file(STRING_ARGS(path)) ? fs_open_file(STRING_ARGS(path), STREAM_IN | STREAM_BINARY) : nullptr;
+    if (stream)
+    {
+        const size_t size = stream_size(stream);
+        if (size >= header.length)
+        {
+            char* buffer = (char*)memory_allocate(HASH_TIMELAPSE, size + 1, 0, 0);
+            if (stream_read(stream, buffer, size) == size && string_equal(buffer, header.length, STRING_ARGS(header)))
+            {
+                // The output stays in the same buffer, moved over the header.
+                output.length = size - header.length;
+                memmove(buffer, buffer + header.length, output.length);
+                buffer[output.length] = '\0';
+                output.str = buffer;
+                found = true;
+
+                // Entries get evicted by modification time, so reading one counts as a use.
+                fs_touch(STRING_ARGS(path));
+            }
+            else
+                memory_deallocate(buffer);
+        }
+        stream_deallocate(stream);
+    }
+
+    string_deallocate(path.str);
+    string_deallocate(header.str);
+    atomic_incr32(found ? &g_hits : &g_misses, memory_order_relaxed);
+    return found;
+}
+
+void write(const char* working_dir, const char* arguments, size_t length, const string_t& output)
+{
+    if (!is_enabled())
+        return;
+
+    PROFILE_SCOPE("cache write");
+    string_t header = entry_header(working_dir, arguments, length);
+    string_t path = entry_path(header);
+    string_t temporary_path = string_allocate_format(STRING_CONST("%.*s.%" PRIx64 ".tmp"), STRING_FORMAT(path), random64());
+
+    stream_t* stream = fs_open_file(STRING_ARGS(temporary_path), STREAM_OUT | STREAM_BINARY | STREAM_CREATE | STREAM_TRUNCATE);
+    if (stream)
+    {
+        stream_write(stream, STRING_ARGS(header));
+        stream_write(stream, STRING_ARGS(output));
+        stream_deallocate(stream);
+
+        // Another session might have written the same entry in the meantime, which is just as good.
+        if (rename(temporary_path.str, path.str) == 0)
+        {
+            atomic_incr32(&g_writes, memory_order_relaxed);
+            const int64_t size = atomic_add64(&g_size, (int64_t)(header.length + output.length), memory_order_relaxed);
+
+            // Writes can come from any thread, the first one over the limit trims for the others.
+            if ((size_t)size > SIZE_LIMIT && atomic_cas32(&g_trimming, 1, 0, memory_order_acquire, memory_order_relaxed))
+            {
+                atomic_store64(&g_size, (int64_t)trim(SIZE_LIMIT), memory_order_relaxed);
+                atomic_store32(&g_trimming, 0, memory_order_release);
+            }
+        }
+        else
+            fs_remove_file(STRING_ARGS(temporary_path));
+    }
+
+    string_deallocate(temporary_path.str);
+    string_deallocate(path.str);
+    string_deallocate(header.str);
+}
+
+stats_t stats()
+{
+    stats_t stats;
+    stats.hits = atomic_load32(&g_hits, memory_order_relaxed);
+    stats.misses = atomic_load32(&g_misses, memory_order_relaxed);
+    stats.writes = atomic_load32(&g_writes, memory_order_relaxed);
+    return stats;
+}
+
+}}
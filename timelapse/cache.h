@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common.h"
+
+namespace timelapse { namespace cache {
+
+    /// Stores the scm command outputs which never change for a given revision (i.e. annotate, diff)
+    /// in the per user application directory, so later sessions read them instead of spawning the command.
+    /// The entries used the least recently get removed once the cache grows past its size limit.
+    /// Nothing gets cached unless initialized (i.e. benchmarks).
+    bool initialize();
+
+    void finalize();
+
+    bool is_enabled();
+
+    /// Returns the cached output of a command run in the given working directory, if any. Can be called from any thread.
+    bool read(const char* working_dir, const char* arguments, size_t length, string_t& output);
+
+    /// Stores the output of a command run in the given working directory. The entry gets written
+    /// aside first, so concurrent sessions only ever read complete entries. Can be called from any thread.
+    void write(const char* working_dir, const char* arguments, size_t length, const string_t& output);
+
+    /// Counters of the cache lookups since initialized, used by the diagnostics overlay.
+    struct stats_t
+    {
+        int hits{};
+        int misses{};
+        int writes{};
+    };
+
+    stats_t stats();
+
+}}
@@ -2,21 +2,159 @@
 
 #include "foundation/string.h"
 #include "foundation/hash.h"
+#include "foundation/log.h"
+#include "foundation/foundation.h"
+#include "foundation/environment.h"
+
+#include <stdio.h>
+
+#if FOUNDATION_ARCH_SSE2
+    #include <immintrin.h>
+    #if FOUNDATION_COMPILER_MSVC
+        #include <intrin.h>
+    #endif
+#endif
 
 #define HASH_COMMON (static_hash_string("common", 6, 14370257353172364778ULL))
 
-size_t string_occurence(const char* str, size_t len, char c)
+// Character scanning, 64 bytes at a time with AVX2 (if the CPU supports it) or SSE2, scalar otherwise.
+// Each match offset is handed in increasing order to the handler.
+
+#if FOUNDATION_COMPILER_MSVC
+    #define COMMON_TARGET_AVX2
+#else
+    #define COMMON_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static FOUNDATION_FORCEINLINE unsigned bit_scan_forward(uint64_t mask)
 {
-    size_t occurence = 0;
+    #if FOUNDATION_COMPILER_MSVC
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return (unsigned)index;
+    #else
+        return (unsigned)__builtin_ctzll(mask);
+    #endif
+}
+
+template <typename Handler>
+static FOUNDATION_FORCEINLINE void scan_char_scalar(const char* str, size_t offset, size_t len, char c, Handler& handler)
+{
+    for (; offset < len; ++offset)
+    {
+        if (str[offset] == c)
+            handler(offset);
+    }
+}
+
+template <typename Handler>
+static FOUNDATION_FORCEINLINE void scan_mask(size_t offset, uint64_t mask, Handler& handler)
+{
+    while (mask)
+    {
+        handler(offset + bit_scan_forward(mask));
+        mask &= mask - 1;
+    }
+}
+
+#if FOUNDATION_ARCH_SSE2
+
+static bool cpu_supports_avx2()
+{
+    #if FOUNDATION_COMPILER_MSVC
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+
+        // AVX registers need to be saved by the OS
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    #else
+        return __builtin_cpu_supports("avx2");
+    #endif
+}
+
+static const bool g_cpu_supports_avx2 = cpu_supports_avx2();
+
+template <typename Handler>
+static void scan_char_sse2(const char* str, size_t len, char c, Handler& handler)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+
     size_t offset = 0;
-    while (true)
+    for (; offset + 64 <= len; offset += 64)
+    {
+        const __m128i* block = (const __m128i*)(str + offset);
+        const uint64_t m0 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 0), needle));
+        const uint64_t m1 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 1), needle));
+        const uint64_t m2 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), needle));
+        const uint64_t m3 = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 3), needle));
+        scan_mask(offset, m0 | (m1 << 16) | (m2 << 32) | (m3 << 48), handler);
+    }
+
+    for (; offset + 16 <= len; offset += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128((const __m128i*)(str + offset));
+        scan_mask(offset, (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)), handler);
+    }
+
+    scan_char_scalar(str, offset, len, c, handler);
+}
+
+template <typename Handler>
+COMMON_TARGET_AVX2 static void scan_char_avx2(const char* str, size_t len, char c, Handler& handler)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+
+    size_t offset = 0;
+    for (; offset + 64 <= len; offset += 64)
+    {
+        const __m256i* block = (const __m256i*)(str + offset);
+        const uint64_t lo = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block + 0), needle));
+        const uint64_t hi = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block + 1), needle));
+        scan_mask(offset, lo | (hi << 32), handler);
+    }
+
+    for (; offset + 32 <= len; offset += 32)
     {
-        size_t foffset = string_find(str, len, c, offset);
-        if (foffset == STRING_NPOS)
-            break;
-        offset = foffset + 1;
-        occurence++;
+        const __m256i chunk = _mm256_loadu_si256((const __m256i*)(str + offset));
+        scan_mask(offset, (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)), handler);
     }
+
+    scan_char_scalar(str, offset, len, c, handler);
+}
+
+#endif
+
+template <typename Handler>
+static void scan_char(const char* str, size_t len, char c, Handler& handler)
+{
+    #if FOUNDATION_ARCH_SSE2
+        // Short strings (i.e. a single log line) are not worth the setup
+        if (len < 64)
+            scan_char_sse2(str, len, c, handler);
+        else if (g_cpu_supports_avx2)
+            scan_char_avx2(str, len, c, handler);
+        else
+            scan_char_sse2(str, len, c, handler);
+    #else
+        scan_char_scalar(str, 0, len, c, handler);
+    #endif
+}
+
+size_t string_occurence(const char* str, size_t len, char c)
+{
+    size_t occurence = 0;
+    size_t offset = 0;
+    auto count = [&](size_t match) { occurence++; offset = match + 1; };
+    scan_char(str, len, c, count);
     return occurence + (offset+1 < len);
 }
 
@@ -27,18 +165,166 @@ size_t string_line_count(const char* str, size_t len)
     return string_occurence(str, len, STRING_NEWLINE[0]);
 }
 
+size_t string_find_all(const char* str, size_t len, char c, generics::vector<size_t>& offsets)
+{
+    const size_t start_count = offsets.size();
+    auto push = [&](size_t match) { offsets.push_back(match); };
+    scan_char(str, len, c, push);
+    return offsets.size() - start_count;
+}
+
 lines_t string_split_lines(const char* str, size_t len)
 {
     lines_t lines;
-    const size_t line_occurence = string_line_count(str, len);
-    lines.items = (string_const_t*)memory_allocate(HASH_COMMON, line_occurence * sizeof string_const_t, 0, 0);
-    lines.count = string_explode(str, len, STRING_CONST(STRING_NEWLINE), lines.items, line_occurence, false);
-    FOUNDATION_ASSERT(lines.count == line_occurence);
+    if (!str || len == 0)
+        return lines;
+
+    // Guess the line count from an average line length, and grow if we guessed too low.
+    size_t capacity = len / 48 + 16;
+    lines.items = (string_const_t*)memory_allocate(HASH_COMMON, capacity * sizeof(string_const_t), 0, 0);
+
+    // Same as exploding on newlines, empty lines are skipped.
+    size_t start = 0;
+    auto push_line = [&](size_t end)
+    {
+        if (end > start)
+        {
+            if (lines.count == capacity)
+            {
+                lines.items = (string_const_t*)memory_reallocate(lines.items, capacity * 2 * sizeof(string_const_t), 0, capacity * sizeof(string_const_t), 0);
+                capacity *= 2;
+            }
+            lines.items[lines.count++] = string_const(str + start, end - start);
+        }
+        start = end + 1;
+    };
+
+    scan_char(str, len, STRING_NEWLINE[0], push_line);
+    push_line(len);
+
     return lines;
 }
 
+size_t string_split_fields(const char* str, size_t len, char delimiter, string_const_t* fields, size_t capacity, bool allow_empty)
+{
+    size_t count = 0;
+    if (!str || len == 0 || capacity == 0)
+        return 0;
+
+    size_t start = 0;
+    auto push_field = [&](size_t end)
+    {
+        if (count < capacity && (allow_empty || end > start))
+            fields[count++] = string_const(str + start, end - start);
+        start = end + 1;
+    };
+
+    scan_char(str, len, delimiter, push_field);
+    if (start < len || (allow_empty && start == len))
+        push_field(len);
+
+    return count;
+}
+
+string_const_t string_scratch_format(const char* format, size_t format_length, ...)
+{
+    FOUNDATION_UNUSED(format_length);
+
+    // Measured and formatted by the same formatter, so the length always matches the text.
+    va_list list;
+    va_start(list, format_length);
+    va_list measure;
+    va_copy(measure, list);
+    const int length = vsnprintf(nullptr, 0, format, measure);
+    va_end(measure);
+
+    if (length <= 0)
+    {
+        va_end(list);
+        return string_const(STRING_CONST(""));
+    }
+
+    char* buffer = (char*)memory_scratch_allocate((size_t)length + 1, 0);
+    vsnprintf(buffer, (size_t)length + 1, format, list);
+    va_end(list);
+    return string_const(buffer, (size_t)length);
+}
+
+static void log_to_stderr(hash_t context, error_level_t severity, const char* msg, size_t length)
+{
+    FOUNDATION_UNUSED(context);
+    FOUNDATION_UNUSED(severity);
+    fprintf(stderr, "%.*s\n", (int)length, msg);
+}
+
+static bool has_results_to_stdout(const char* const* stdout_modes, size_t mode_count)
+{
+    bool has_mode = false;
+    const string_const_t* cmdline = environment_command_line();
+    for (size_t i = 1, end = array_size(cmdline); i < end; ++i)
+    {
+        if (string_equal(STRING_ARGS(cmdline[i]), STRING_CONST("--output")))
+            return false;
+        for (size_t m = 0; m < mode_count; ++m)
+            has_mode = has_mode || string_equal(STRING_ARGS(cmdline[i]), stdout_modes[m], strlen(stdout_modes[m]));
+    }
+    return has_mode;
+}
+
+int initialize_foundation(const memory_system_t& memory, const application_t& application, const foundation_config_t& config,
+    const char* const* stdout_modes, size_t mode_count)
+{
+    log_enable_stdout(false);
+    log_set_handler(log_to_stderr);
+
+    const int result = foundation_initialize(memory, application, config);
+    if (result == 0 && !has_results_to_stdout(stdout_modes, mode_count))
+    {
+        log_set_handler(nullptr);
+        log_enable_stdout(true);
+    }
+    return result;
+}
+
 void string_lines_finalize(lines_t& lines)
 {
     memory_deallocate(lines.items);
+    lines.items = nullptr;
     lines.count = 0;
 }
+
+static bool parse_digits(const char* str, size_t count, int& value)
+{
+    value = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (str[i] < '0' || str[i] > '9')
+            return false;
+        value = value * 10 + (str[i] - '0');
+    }
+    return true;
+}
+
+time_t string_to_date(const char* str, size_t len)
+{
+    // i.e. 2018-06-22
+    int year = 0, month = 0, day = 0;
+    if (len < 10 || str[4] != '-' || str[7] != '-' ||
+        !parse_digits(str, 4, year) || !parse_digits(str + 5, 2, month) || !parse_digits(str + 8, 2, day))
+    {
+        time_t now;
+        time(&now);
+        return now;
+    }
+
+    // Days since 1970-01-01 computed directly (mktime locks the CRT time zone data and
+    // serializes threads parsing annotations).
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int year_of_era = year - era * 400;
+    const int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    const long long days = (long long)era * 146097 + day_of_era - 719468;
+
+    return (time_t)(days * 86400);
+}
@@ -2,6 +2,32 @@
 
 #include "foundation/assert.h"
 #include "foundation/memory.h"
+#include "foundation/atomic.h"
+#include "foundation/profile.h"
+
+#include <time.h>
+
+/// Makes a memory arena the active allocator of the calling thread until the end of the scope.
+struct scoped_arena_t
+{
+    explicit scoped_arena_t(memory_arena_t* arena) { memory_arena_push(arena); }
+    ~scoped_arena_t() { memory_arena_pop(); }
+
+    scoped_arena_t(const scoped_arena_t&) = delete;
+    scoped_arena_t& operator=(const scoped_arena_t&) = delete;
+};
+
+/// Profiles the rest of the scope as a named block (names are truncated to 25 characters in the profile stream).
+struct scoped_profile_block_t
+{
+    scoped_profile_block_t(const char* name, size_t length) { profile_begin_block(name, length); }
+    ~scoped_profile_block_t() { profile_end_block(); }
+
+    scoped_profile_block_t(const scoped_profile_block_t&) = delete;
+    scoped_profile_block_t& operator=(const scoped_profile_block_t&) = delete;
+};
+
+#define PROFILE_SCOPE(name) scoped_profile_block_t FOUNDATION_PREPROCESSOR_JOIN(profile_block_, __LINE__)(STRING_CONST(name))
 
 struct lines_t
 {
@@ -30,7 +56,18 @@ int num_digits(T number)
 size_t string_occurence(const char* str, size_t len, char c);
 size_t string_line_count(const char* str, size_t len);
 lines_t string_split_lines(const char* str, size_t len);
+size_t string_split_fields(const char* str, size_t len, char delimiter, string_const_t* fields, size_t capacity, bool allow_empty);
 void string_lines_finalize(lines_t& lines);
+time_t string_to_date(const char* str, size_t len);
+
+/// Format a string into per-thread scratch memory, valid until the end of the current frame (see memory_scratch_reset).
+string_const_t string_scratch_format(const char* format, size_t format_length, ...) FOUNDATION_PRINTFCALL(1, 3);
+
+/// Initializes foundation, routing the log to stderr for the whole run when results get written to stdout, so they stay
+/// parseable: that is when the command line holds one of the given output modes without --output. Nothing gets logged to
+/// stdout until the command line is known.
+int initialize_foundation(const memory_system_t& memory, const application_t& application, const foundation_config_t& config,
+    const char* const* stdout_modes, size_t mode_count);
 
 namespace generics {
 
@@ -189,7 +226,7 @@ namespace generics {
         {
             if (new_capacity <= Capacity)
                 return;
-            value_type* new_data = (value_type*)memory_allocate(0, (size_t)new_capacity * sizeof(value_type), 0, 0);
+            value_type* new_data = (value_type*)memory_allocate(0, (size_t)new_capacity * sizeof(value_type), 0, MEMORY_NO_ARENA);
             if (Data)
             {
                 memcpy(new_data, Data, (size_t)Size * sizeof(value_type));
@@ -221,7 +258,7 @@ namespace generics {
 
         iterator erase(const_iterator it)
         {
-            IM_ASSERT(it >= Data && it < Data + Size);
+            FOUNDATION_ASSERT(it >= Data && it < Data + Size);
             const ptrdiff_t off = it - Data;
             memmove(Data + off, Data + off + 1, ((size_t)Size - (size_t)off - 1) * sizeof(value_type));
             Size--;
@@ -230,7 +267,7 @@ namespace generics {
 
         iterator erase(const_iterator it, const_iterator it_last)
         {
-            IM_ASSERT(it >= Data && it < Data + Size && it_last > it && it_last <= Data + Size);
+            FOUNDATION_ASSERT(it >= Data && it < Data + Size && it_last > it && it_last <= Data + Size);
             const ptrdiff_t count = it_last - it;
             const ptrdiff_t off = it - Data;
             memmove(Data + off, Data + off + count, ((size_t)Size - (size_t)off - count) * sizeof(value_type));
@@ -240,7 +277,7 @@ namespace generics {
 
         iterator erase_unsorted(const_iterator it)
         {
-            IM_ASSERT(it >= Data && it < Data + Size);
+            FOUNDATION_ASSERT(it >= Data && it < Data + Size);
             const ptrdiff_t off = it - Data;
             if (it < Data + Size - 1) memcpy(Data + off, Data + Size - 1, sizeof(value_type));
             Size--;
@@ -249,7 +286,7 @@ namespace generics {
 
         iterator insert(const_iterator it, const value_type& v)
         {
-            IM_ASSERT(it >= Data && it <= Data + Size);
+            FOUNDATION_ASSERT(it >= Data && it <= Data + Size);
             const ptrdiff_t off = it - Data;
             if (Size == Capacity) reserve(_grow_capacity(Size + 1));
             if (off < (size_t)Size) memmove(Data + off + 1, Data + off, ((size_t)Size - (size_t)off) * sizeof(value_type));
@@ -266,4 +303,72 @@ namespace generics {
             return false;
         }
     };
+
+    /// Intrusive lock-free queue with multiple producers and a single consumer.
+    /// Items are linked through their `T* next` member and are popped in the order they were pushed.
+    template<typename T>
+    class mpsc_queue
+    {
+    public:
+        mpsc_queue()
+            : pending(nullptr)
+        {
+            atomic_store_ptr(&head, nullptr, memory_order_relaxed);
+        }
+
+        mpsc_queue(const mpsc_queue&) = delete;
+        mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+        /// Can be called from any thread.
+        void push(T* item)
+        {
+            void* top;
+            do
+            {
+                top = atomic_load_ptr(&head, memory_order_relaxed);
+                item->next = (T*)top;
+            } while (!atomic_cas_ptr(&head, item, top, memory_order_release, memory_order_relaxed));
+        }
+
+        /// Must only be called from the consumer thread, returns nullptr if the queue is empty.
+        T* pop()
+        {
+            if (pending == nullptr)
+            {
+                // Grab everything pushed so far and reverse it to restore the push order.
+                void* items;
+                do
+                {
+                    items = atomic_load_ptr(&head, memory_order_relaxed);
+                } while (items && !atomic_cas_ptr(&head, nullptr, items, memory_order_acquire, memory_order_relaxed));
+
+                T* item = (T*)items;
+                while (item)
+                {
+                    T* next = item->next;
+                    item->next = pending;
+                    pending = item;
+                    item = next;
+                }
+            }
+
+            T* item = pending;
+            if (item)
+                pending = item->next;
+            return item;
+        }
+
+        /// Must only be called from the consumer thread.
+        bool empty() const
+        {
+            return pending == nullptr && atomic_load_ptr(&head, memory_order_acquire) == nullptr;
+        }
+
+    private:
+        atomicptr_t head;
+        T* pending;
+    };
 }
+
+/// Appends the offset of each occurence of c in str, returns the number of offsets added.
+size_t string_find_all(const char* str, size_t len, char c, generics::vector<size_t>& offsets);
@@ -0,0 +1,136 @@
+#include "diagnostics.h"
+#include "timing.h"
+#include "scm_proxy.h"
+#include "cache.h"
+#include "pool.h"
+#include "session.h"
+
+#include "foundation/string.h"
+#include "foundation/hashstrings.h"
+
+#include <imgui/imgui.h>
+
+#define HASH_SCM (static_hash_string("scm", 3, 3754008690416994104ULL))
+#define HASH_COMMON (static_hash_string("common", 6, 14370257353172364778ULL))
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace diagnostics {
+
+using timing::FRAME_HISTORY_COUNT;
+const int SECTION_COUNT = (int)timing::section_t::count;
+
+static const char* SECTION_NAMES[SECTION_COUNT] = {
+    "session update",
+    "render main menu",
+    "render change list",
+    "render revision controls",
+    "render patch view",
+    "render annotations view",
+    "gl submit"
+};
+
+struct memory_context_t
+{
+    const char* name;
+    hash_t context;
+};
+
+static const memory_context_t MEMORY_CONTEXTS[] = {
+    { "scm", HASH_SCM },
+    { "common", HASH_COMMON },
+    { "timelapse", HASH_TIMELAPSE }
+};
+
+static void history_stats(const float* values, float& last, float& average, float& peak)
+{
+    last = average = peak = 0;
+    const int history_count = timing::history_count();
+    const int history_offset = timing::history_offset();
+    if (history_count == 0)
+        return;
+
+    const int first = (history_offset + FRAME_HISTORY_COUNT - history_count) % FRAME_HISTORY_COUNT;
+    for (int i = 0; i < history_count; ++i)
+    {
+        const float value = values[(first + i) % FRAME_HISTORY_COUNT];
+        average += value;
+        peak = value > peak ? value : peak;
+    }
+    average /= history_count;
+    last = values[(history_offset + FRAME_HISTORY_COUNT - 1) % FRAME_HISTORY_COUNT];
+}
+
+void render(bool* open)
+{
+    if (!*open)
+        return;
+
+    ImGuiIO& io = ImGui::GetIO();
+    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x - 10.0f, 30.0f), ImGuiCond_FirstUseEver, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (!ImGui::Begin("Diagnostics", open, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing))
+    {
+        ImGui::End();
+        return;
+    }
+
+    float last, average, peak;
+    const float* frame_times = timing::frame_times();
+    history_stats(frame_times, last, average, peak);
+
+    char overlay[64];
+    string_format(STRING_CONST(overlay), STRING_CONST("%.2f ms (avg %.2f, max %.2f)"), last, average, peak);
+    ImGui::PlotLines("##frame_times", frame_times, FRAME_HISTORY_COUNT, timing::history_offset(), overlay,
+        0.0f, peak > 1000.0f / 60.0f ? peak : 1000.0f / 60.0f, ImVec2(320.0f, 60.0f));
+
+    ImGui::Separator();
+    ImGui::Columns(4, "sections", false);
+    ImGui::TextUnformatted("Section"); ImGui::NextColumn();
+    ImGui::TextUnformatted("Last"); ImGui::NextColumn();
+    ImGui::TextUnformatted("Avg"); ImGui::NextColumn();
+    ImGui::TextUnformatted("Max"); ImGui::NextColumn();
+    for (int i = 0; i < SECTION_COUNT; ++i)
+    {
+        history_stats(timing::section_times((timing::section_t)i), last, average, peak);
+        ImGui::TextUnformatted(SECTION_NAMES[i]); ImGui::NextColumn();
+        ImGui::Text("%.2f ms", last); ImGui::NextColumn();
+        ImGui::Text("%.2f ms", average); ImGui::NextColumn();
+        ImGui::Text("%.2f ms", peak); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    ImGui::Separator();
+    const scm::stats_t scm_stats = scm::stats();
+    ImGui::Text("SCM requests: %d running, %d queued", scm_stats.running_requests, scm_stats.queued_requests);
+    ImGui::Text("SCM processes: %d running, %d spawned", scm_stats.running_processes, scm_stats.spawned_processes);
+    const cache::stats_t cache_stats = cache::stats();
+    ImGui::Text("SCM cache: %d hits, %d misses, %d writes", cache_stats.hits, cache_stats.misses, cache_stats.writes);
+    const pool::stats_t pool_stats = pool::stats();
+    ImGui::Text("Line pool: %" PRIsize " lines, %" PRIsize " strings, %.2f MB", pool_stats.lines, pool_stats.strings, pool_stats.memory / (1024.0 * 1024.0));
+    const session::working_set_stats_t working_set = session::working_set_stats();
+    ImGui::Text("Revisions: %" PRIsize " resident (%.2f + %.2f pooled / %.2f MB), %" PRIsize " compressed (%.2f MB)",
+        working_set.resident_revisions, working_set.resident / (1024.0 * 1024.0), working_set.pool / (1024.0 * 1024.0),
+        working_set.working_set / (1024.0 * 1024.0), working_set.compressed_revisions, working_set.compressed / (1024.0 * 1024.0));
+
+    ImGui::Separator();
+    ImGui::Columns(3, "memory", false);
+    ImGui::TextUnformatted("Memory"); ImGui::NextColumn();
+    ImGui::TextUnformatted("Allocations"); ImGui::NextColumn();
+    ImGui::TextUnformatted("Size"); ImGui::NextColumn();
+    for (const auto& memory_context : MEMORY_CONTEXTS)
+    {
+        const memory_statistics_t stats = memory_context_statistics(memory_context.context);
+        ImGui::TextUnformatted(memory_context.name); ImGui::NextColumn();
+        ImGui::Text("%u", stats.allocations_current); ImGui::NextColumn();
+        ImGui::Text("%.2f MB", stats.allocated_current / (1024.0 * 1024.0)); ImGui::NextColumn();
+    }
+    const memory_statistics_t total = memory_statistics();
+    ImGui::TextUnformatted("total"); ImGui::NextColumn();
+    ImGui::Text("%u", total.allocations_current); ImGui::NextColumn();
+    ImGui::Text("%.2f MB", total.allocated_current / (1024.0 * 1024.0)); ImGui::NextColumn();
+    ImGui::Columns(1);
+
+    ImGui::End();
+}
+
+}}
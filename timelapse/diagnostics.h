@@ -0,0 +1,11 @@
+#pragma once
+
+#include "common.h"
+
+namespace timelapse { namespace diagnostics {
+
+    /// Renders the diagnostics overlay window, which can be closed through the open flag. Frame and section times
+    /// come from the frame timing (see timing.h).
+    void render(bool* open);
+
+}}
@@ -0,0 +1,510 @@
+#include "headless.h"
+#include "scm_proxy.h"
+#include "cache.h"
+
+#include "foundation/environment.h"
+#include "foundation/path.h"
+#include "foundation/fs.h"
+#include "foundation/stream.h"
+#include "foundation/beacon.h"
+#include "foundation/system.h"
+#include "foundation/array.h"
+#include "foundation/log.h"
+#include "foundation/hash.h"
+#include "foundation/hashstrings.h"
+#include "foundation/time.h"
+#include "foundation/thread.h"
+
+#include <algorithm>
+
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace headless {
+
+// Time waited for a request to complete before scheduling again, in case a completion got missed.
+const unsigned COMPLETED_REQUEST_WAIT_MS = 100;
+
+// Pre-warming samples the machine load that often, leaving some cores idle for the user, and
+// pauses whenever the other processes keep most of the cores busy.
+const deltatime_t LOAD_SAMPLE_PERIOD = 2.0;
+const double RESERVED_IDLE_CORES = 1.0;
+const double BUSY_LOAD = 0.75;
+
+// Lines interned past that size get released once the requests in flight complete, since all the annotations
+// handed over by the completed requests are released once exported.
+const size_t POOL_FLUSH_SIZE = 64 * 1024 * 1024;
+
+struct options_t
+{
+    bool prewarm{};
+    size_t job_count{};
+    deltatime_t interval{};
+    string_const_t output{};
+};
+
+struct file_t
+{
+    string_t path{};
+    string_t dir{};
+
+    // Revision list, alive from the time it gets fetched until all the revisions got exported
+    generics::vector<scm::revision_t> revisions;
+    memory_arena_t* arena{};
+
+    size_t next_revision{};
+    size_t pending_requests{};
+    size_t exported_revisions{};
+    size_t failed_revisions{};
+    size_t warm_revisions{};
+};
+
+struct request_slot_t
+{
+    scm::request_t request;
+    size_t file;
+    size_t revision;
+};
+
+// Revision index of the slots fetching a revision list
+const size_t REVISIONS_REQUEST = (size_t)-1;
+
+static beacon_t* g_request_completed = nullptr;
+
+static void request_completed()
+{
+    beacon_fire(g_request_completed);
+}
+
+static void write_string(stream_t* stream, const char* str, size_t length)
+{
+    stream_write(stream, "\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        const char c = str[i];
+        if (c != '"' && c != '\\' && (unsigned char)c >= 0x20)
+            continue;
+
+        stream_write(stream, str + run, i - run);
+        if (c == '"' || c == '\\')
+        {
+            const char escaped[2] = { '\\', c };
+            stream_write(stream, escaped, sizeof(escaped));
+        }
+        else
+            stream_write_format(stream, STRING_CONST("\\u%04x"), (unsigned)(unsigned char)c);
+        run = i + 1;
+    }
+    stream_write(stream, str + run, length - run);
+    stream_write(stream, "\"", 1);
+}
+
+static void write_field(stream_t* stream, const char* name, size_t name_length, const string_t& value)
+{
+    stream_write_format(stream, STRING_CONST(",\"%.*s\":"), (int)name_length, name);
+    write_string(stream, value.str ? value.str : "", value.length);
+}
+
+/// Writes a revision and the blame of each of its lines, i.e.
+/// {"file":"...","id":12,"rev":"...",...,"lines":[["rev","author","date"],...]}
+static void write_revision(stream_t* stream, const file_t& file, const scm::revision_t& rev, const scm::annotations_t& annotations)
+{
+    stream_write(stream, "{\"file\":", 8);
+    write_string(stream, STRING_ARGS(file.path));
+    stream_write_format(stream, STRING_CONST(",\"id\":%d"), rev.id);
+    write_field(stream, STRING_CONST("rev"), rev.rev);
+    write_field(stream, STRING_CONST("author"), rev.author);
+    write_field(stream, STRING_CONST("branch"), rev.branch);
+    write_field(stream, STRING_CONST("date"), rev.date);
+    write_field(stream, STRING_CONST("merged_date"), annotations.date);
+    write_field(stream, STRING_CONST("description"), rev.description);
+
+    stream_write(stream, ",\"lines\":[", 10);
+    for (unsigned i = 0, end = array_size(annotations.lines); i < end; ++i)
+    {
+        const pool::line_t& line = pool::line(annotations.lines[i]);
+        const string_const_t line_rev = pool::string(line.rev);
+        const string_const_t line_author = pool::string(line.author);
+        const string_const_t line_date = pool::string(line.date);
+        stream_write(stream, i == 0 ? "[" : ",[", i == 0 ? 1 : 2);
+        write_string(stream, STRING_ARGS(line_rev));
+        stream_write(stream, ",", 1);
+        write_string(stream, STRING_ARGS(line_author));
+        stream_write(stream, ",", 1);
+        write_string(stream, STRING_ARGS(line_date));
+        stream_write(stream, "]", 1);
+    }
+    stream_write(stream, "]}\n", 3);
+}
+
+static void file_finalize(file_t& file)
+{
+    for (auto& rev : file.revisions)
+        scm::revision_deallocate(rev);
+    file.revisions.clear();
+    memory_arena_deallocate(file.arena);
+    file.arena = nullptr;
+
+    string_deallocate(file.path.str);
+    string_deallocate(file.dir.str);
+    file.path = file.dir = {};
+}
+
+/// Returns how many requests can run at once. Pre-warming only uses the cores left idle by the other
+/// processes, sampled every few seconds, and pauses altogether while the machine is busy.
+static size_t request_budget(const options_t& options, size_t running_requests)
+{
+    if (!options.prewarm)
+        return options.job_count;
+
+    static tick_t s_sample_time = 0;
+    static uint64_t s_busy = 0, s_total = 0;
+    static size_t s_budget = 1;
+    if (s_sample_time != 0 && time_elapsed(s_sample_time) < LOAD_SAMPLE_PERIOD)
+        return s_budget;
+
+    uint64_t busy, total;
+    if (!system_cpu_times(&busy, &total))
+        return options.job_count;
+
+    if (s_sample_time != 0 && total > s_total)
+    {
+        // Our own requests keep cores busy too, only the cores used by everything else count.
+        const double core_count = (double)system_hardware_threads();
+        const double busy_cores = core_count * (double)(busy - s_busy) / (double)(total - s_total);
+        const double other_busy_cores = generics::max(0.0, busy_cores - (double)running_requests);
+        const size_t idle_cores = (size_t)generics::max(1.0, core_count - other_busy_cores - RESERVED_IDLE_CORES);
+        const size_t budget = other_busy_cores > core_count * BUSY_LOAD ? 0 : generics::min(options.job_count, idle_cores);
+
+        if (budget == 0 && s_budget > 0)
+            log_info(HASH_TIMELAPSE, STRING_CONST("Machine is busy, pausing pre-warming"));
+        else if (budget > 0 && s_budget == 0)
+            log_info(HASH_TIMELAPSE, STRING_CONST("Resuming pre-warming"));
+        s_budget = budget;
+    }
+
+    s_sample_time = time_current();
+    s_busy = busy;
+    s_total = total;
+    return s_budget;
+}
+
+/// Key of a revision of a file in the sorted list of the revisions pre-warmed by the previous passes.
+static hash_t warm_key(const file_t& file, const scm::revision_t& rev)
+{
+    return hash(STRING_ARGS(file.path)) * 31 + hash(STRING_ARGS(rev.rev));
+}
+
+static bool is_warm(const generics::vector<hash_t>* warm, hash_t key)
+{
+    return warm && std::binary_search(warm->begin(), warm->end(), key);
+}
+
+/// Skips the revisions annotated by a previous pre-warming pass, their commands would only read the cache again.
+static void skip_warm_revisions(file_t& file, const generics::vector<hash_t>* warm)
+{
+    while (file.next_revision < file.revisions.size() && is_warm(warm, warm_key(file, file.revisions[file.next_revision])))
+    {
+        file.next_revision++;
+        file.warm_revisions++;
+    }
+}
+
+static void add_file(generics::vector<file_t>& files, string_t path)
+{
+    file_t file;
+    file.path = path;
+    file.dir = string_clone_string(path_directory_name(STRING_ARGS(path)));
+    files.push_back(file);
+}
+
+/// Adds the file at the given path, or the files matching it if its file name holds * or ? wildcards (i.e. src/*.cpp).
+static void add_files(generics::vector<file_t>& files, const string_const_t& arg)
+{
+    string_t path = path_allocate_absolute(STRING_ARGS(arg));
+    const string_const_t pattern = path_file_name(STRING_ARGS(path));
+    if (string_find_first_of(STRING_ARGS(pattern), STRING_CONST("*?"), 0) == STRING_NPOS)
+    {
+        if (fs_is_file(STRING_ARGS(path)))
+        {
+            add_file(files, path);
+            return;
+        }
+
+        log_warnf(HASH_TIMELAPSE, WARNING_INVALID_VALUE, STRING_CONST("Skipping %.*s, not a file"), STRING_FORMAT(path));
+        string_deallocate(path.str);
+        return;
+    }
+
+    const string_const_t directory = path_directory_name(STRING_ARGS(path));
+    string_t* names = fs_files(STRING_ARGS(directory));
+    for (unsigned i = 0, end = array_size(names); i < end; ++i)
+    {
+        if (string_match_pattern(STRING_ARGS(names[i]), STRING_ARGS(pattern)))
+            add_file(files, path_allocate_concat(STRING_ARGS(directory), STRING_ARGS(names[i])));
+    }
+    string_array_deallocate(names);
+    string_deallocate(path.str);
+}
+
+static bool is_option(const string_const_t& arg)
+{
+    return arg.length > 2 && arg.str[0] == '-' && arg.str[1] == '-';
+}
+
+static options_t parse_options()
+{
+    options_t options;
+    options.job_count = system_hardware_threads();
+
+    const string_const_t* cmdline = environment_command_line();
+    for (int i = 1, end = array_size(cmdline); i < end; ++i)
+    {
+        const string_const_t& arg = cmdline[i];
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--headless")))
+            continue;
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--prewarm")))
+        {
+            options.prewarm = true;
+            continue;
+        }
+        if (!is_option(arg) || i + 1 == end)
+            continue;
+
+        const string_const_t& value = cmdline[++i];
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--jobs")))
+            options.job_count = generics::max(1, string_to_int(STRING_ARGS(value)));
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--output")))
+            options.output = value;
+        else if (string_equal(STRING_ARGS(arg), STRING_CONST("--interval")))
+            options.interval = string_to_real(STRING_ARGS(value));
+    }
+
+    return options;
+}
+
+/// Lists the files given on the command line, the patterns get matched again on each pre-warming pass.
+static void collect_files(generics::vector<file_t>& files)
+{
+    const string_const_t* cmdline = environment_command_line();
+    for (int i = 1, end = array_size(cmdline); i < end; ++i)
+    {
+        const string_const_t& arg = cmdline[i];
+        if (string_equal(STRING_ARGS(arg), STRING_CONST("--headless")) || string_equal(STRING_ARGS(arg), STRING_CONST("--prewarm")))
+            continue;
+        if (is_option(arg))
+        {
+            ++i;
+            continue;
+        }
+
+        add_files(files, arg);
+    }
+}
+
+/// Fetches the revisions and annotations of the files, writing the revisions to the stream if any. When given the
+/// revisions pre-warmed so far, those get skipped and the ones annotated get added.
+/// Returns the number of files which failed, either without revisions or failing to annotate some revision.
+static size_t fetch_files(generics::vector<file_t>& files, stream_t* stream, const options_t& options, generics::vector<hash_t>* warm)
+{
+    // Files which got their revision list requested, but still have revisions to fetch
+    generics::vector<size_t> open_files;
+    generics::vector<request_slot_t> requests;
+    size_t next_file = 0, finished_files = 0, failed_files = 0, fetched_revisions = 0, warm_revisions = 0;
+    const tick_t start = time_current();
+
+    while (finished_files < files.size())
+    {
+        // Nothing gets scheduled while flushing the line pool, until no request references it anymore.
+        const size_t pool_memory = pool::stats().memory;
+        bool flush_pool = pool_memory > POOL_FLUSH_SIZE;
+        if (flush_pool && requests.empty())
+        {
+            log_debugf(HASH_TIMELAPSE, STRING_CONST("Flushing the line pool (%" PRIsize " bytes)"), pool_memory);
+            pool::reset();
+            flush_pool = false;
+        }
+
+        // Fill the concurrency budget, finishing the files already opened first so only
+        // a few revision lists are alive at once, before opening new ones.
+        const size_t budget = flush_pool ? 0 : request_budget(options, requests.size());
+        while (requests.size() < budget)
+        {
+            request_slot_t slot = { 0, 0, 0 };
+            for (const auto& index : open_files)
+            {
+                file_t& file = files[index];
+                skip_warm_revisions(file, warm);
+                if (file.next_revision < file.revisions.size())
+                {
+                    slot.file = index;
+                    slot.revision = file.next_revision++;
+                    const scm::revision_t& rev = file.revisions[slot.revision];
+                    slot.request = scm::fetch_revision_annotations(file.path.str, file.dir.str, rev.id, rev.rev.str);
+                    file.pending_requests++;
+                    break;
+                }
+            }
+
+            if (slot.request == 0 && next_file < files.size())
+            {
+                file_t& file = files[next_file];
+                slot.file = next_file++;
+                slot.revision = REVISIONS_REQUEST;
+                slot.request = scm::fetch_revisions(file.path.str, file.dir.str, false);
+                file.pending_requests++;
+                open_files.push_back(slot.file);
+            }
+
+            if (slot.request == 0)
+                break;
+            requests.push_back(slot);
+        }
+
+        scm::request_t request = scm::pop_completed_request();
+        if (request == 0)
+        {
+            beacon_try_wait(g_request_completed, COMPLETED_REQUEST_WAIT_MS);
+            continue;
+        }
+
+        size_t slot_index = 0;
+        while (slot_index < requests.size() && requests[slot_index].request != request)
+            ++slot_index;
+        FOUNDATION_ASSERT(slot_index < requests.size());
+        const request_slot_t slot = requests[slot_index];
+        requests[slot_index] = requests.back();
+        requests.pop_back();
+
+        file_t& file = files[slot.file];
+        if (slot.revision == REVISIONS_REQUEST)
+        {
+            file.revisions = scm::request_revisions(request, file.arena);
+            if (file.revisions.empty())
+                log_warnf(HASH_TIMELAPSE, WARNING_RESOURCE, STRING_CONST("No revisions found for %.*s"), STRING_FORMAT(file.path));
+            skip_warm_revisions(file, warm);
+        }
+        else
+        {
+            scm::annotations_t annotations = scm::revision_annotations(request);
+            const scm::revision_t& rev = file.revisions[slot.revision];
+            if (array_size(annotations.lines) > 0)
+            {
+                if (stream)
+                    write_revision(stream, file, rev, annotations);
+                if (warm)
+                {
+                    const hash_t key = warm_key(file, rev);
+                    warm->insert(std::lower_bound(warm->begin(), warm->end(), key), key);
+                }
+                file.exported_revisions++;
+            }
+            else
+            {
+                log_warnf(HASH_TIMELAPSE, WARNING_RESOURCE, STRING_CONST("Failed to annotate %.*s at revision %d"), STRING_FORMAT(file.path), rev.id);
+                file.failed_revisions++;
+            }
+            scm::annotations_finailze(annotations);
+        }
+        scm::dispose_request(request);
+        file.pending_requests--;
+
+        if (file.pending_requests == 0 && file.next_revision == file.revisions.size())
+        {
+            log_debugf(HASH_TIMELAPSE, STRING_CONST("Fetched %" PRIsize " revisions of %.*s (%" PRIsize " failed)"),
+                file.exported_revisions, STRING_FORMAT(file.path), file.failed_revisions);
+            if (file.revisions.empty() || file.failed_revisions > 0)
+                failed_files++;
+            fetched_revisions += file.exported_revisions;
+            warm_revisions += file.warm_revisions;
+            finished_files++;
+            file_finalize(file);
+
+            size_t open_index = 0;
+            while (open_files[open_index] != slot.file)
+                ++open_index;
+            for (; open_index + 1 < open_files.size(); ++open_index)
+                open_files[open_index] = open_files[open_index + 1];
+            open_files.pop_back();
+        }
+    }
+
+    const cache::stats_t cache_stats = cache::stats();
+    log_infof(HASH_TIMELAPSE, STRING_CONST("Fetched %" PRIsize " revisions of %" PRIsize " files in %.3f seconds (%" PRIsize " already warm, %" PRIsize " files failed, %d cache hits, %d cache writes)"),
+        fetched_revisions, files.size(), time_elapsed(start), warm_revisions, failed_files, cache_stats.hits, cache_stats.writes);
+
+    // All the annotations got released once exported, the next pass starts from an empty line pool.
+    pool::reset();
+    return failed_files;
+}
+
+bool is_requested()
+{
+    const string_const_t* cmdline = environment_command_line();
+    for (int i = 1, end = array_size(cmdline); i < end; ++i)
+    {
+        if (string_equal(STRING_ARGS(cmdline[i]), STRING_CONST("--headless")) || string_equal(STRING_ARGS(cmdline[i]), STRING_CONST("--prewarm")))
+            return true;
+    }
+    return false;
+}
+
+int run()
+{
+    const options_t options = parse_options();
+
+    generics::vector<file_t> files;
+    collect_files(files);
+    if (files.empty())
+    {
+        if (options.prewarm)
+            log_error(HASH_TIMELAPSE, ERROR_INVALID_VALUE, STRING_CONST("Usage: timelapse --prewarm [--jobs <count>] [--interval <seconds>] <file or pattern>..."));
+        else
+            log_error(HASH_TIMELAPSE, ERROR_INVALID_VALUE, STRING_CONST("Usage: timelapse --headless [--jobs <count>] [--output <file.jsonl>] <file or pattern>..."));
+        return -1;
+    }
+
+    // Pre-warming only fills the cache, nothing gets exported.
+    stream_t* stream = nullptr;
+    if (!options.prewarm)
+    {
+        stream = options.output.length ?
+            fs_open_file(STRING_ARGS(options.output), STREAM_OUT | STREAM_CREATE | STREAM_TRUNCATE) : stream_open_stdout();
+        if (!stream)
+        {
+            log_errorf(HASH_TIMELAPSE, ERROR_ACCESS_DENIED, STRING_CONST("Unable to open headless output: %.*s"), STRING_FORMAT(options.output));
+            for (auto& file : files)
+                file_finalize(file);
+            return -1;
+        }
+    }
+
+    cache::initialize();
+    scm::set_low_priority(options.prewarm);
+    g_request_completed = beacon_allocate();
+    scm::set_request_completed_handler(request_completed);
+
+    // Each pre-warming pass only annotates the revisions committed since the previous one, the
+    // others are skipped altogether. The files matching the patterns are listed again too.
+    generics::vector<hash_t> warm;
+    size_t failed_files = fetch_files(files, stream, options, options.prewarm ? &warm : nullptr);
+    while (options.prewarm && options.interval > 0)
+    {
+        thread_sleep((unsigned)(options.interval * 1000.0));
+
+        files.clear();
+        collect_files(files);
+        failed_files = fetch_files(files, stream, options, &warm);
+    }
+
+    scm::set_request_completed_handler(nullptr);
+    beacon_deallocate(g_request_completed);
+    g_request_completed = nullptr;
+    scm::set_low_priority(false);
+    cache::finalize();
+    stream_deallocate(stream);
+
+    return failed_files > 0 ? 1 : 0;
+}
+
+}}
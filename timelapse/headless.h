@@ -0,0 +1,25 @@
+#pragma once
+
+#include "common.h"
+
+namespace timelapse { namespace headless {
+
+    /// Is the application started with --headless or --prewarm, in which case no window gets created and
+    /// run() fetches the blame over time of the files given on the command line.
+    bool is_requested();
+
+    /// Fetches the revisions and annotations of every file given on the command line, then returns the process exit code.
+    ///
+    ///   timelapse --headless [--jobs <count>] [--output <file.jsonl>] <file or pattern>...
+    ///
+    /// writes each revision as a JSON line to the output file (or stdout). The files are fetched in parallel,
+    /// but no more than --jobs scm requests (one per hardware thread by default) run at once across all the files.
+    ///
+    ///   timelapse --prewarm [--jobs <count>] [--interval <seconds>] <file or pattern>...
+    ///
+    /// only fills the scm cache read by the next sessions (see cache.h), at low priority on the cores left
+    /// idle, pausing while the machine is busy. With an interval, the files are fetched again periodically,
+    /// which only spawns commands for the new revisions.
+    int run();
+
+}}
@@ -0,0 +1,171 @@
+#include "patch.h"
+
+#include "foundation/string.h"
+
+namespace timelapse { namespace patch {
+
+static bool starts_with(const string_const_t& line, const char* prefix, size_t prefix_length)
+{
+    return line.length >= prefix_length && string_equal(line.str, prefix_length, prefix, prefix_length);
+}
+
+static const char* parse_number(const char* str, const char* end, int& value)
+{
+    value = 0;
+    while (str < end && *str >= '0' && *str <= '9')
+        value = value * 10 + (*str++ - '0');
+    return str;
+}
+
+static const char* parse_range(const char* str, const char* end, char marker, int& start, int& count)
+{
+    while (str < end && *str != marker)
+        ++str;
+    if (str == end)
+        return str;
+
+    str = parse_number(str + 1, end, start);
+    if (str < end && *str == ',')
+        return parse_number(str + 1, end, count);
+
+    count = 1;
+    return str;
+}
+
+static string_const_t parse_file_name(string_const_t line)
+{
+    // Skip the "--- " or "+++ " marker and any trailing timestamp
+    string_const_t name = string_substr(STRING_ARGS(line), 4, line.length);
+    const size_t tab = string_find(STRING_ARGS(name), '\t', 0);
+    if (tab != STRING_NPOS)
+        name.length = tab;
+    if (starts_with(name, STRING_CONST("a/")) || starts_with(name, STRING_CONST("b/")))
+        name = string_substr(STRING_ARGS(name), 2, name.length);
+    return name;
+}
+
+patch_t parse(const char* str, size_t length)
+{
+    patch_t patch;
+
+    int old_remaining = 0, new_remaining = 0;
+    size_t offset = 0;
+    while (offset < length)
+    {
+        size_t eol = string_find(str, length, STRING_NEWLINE[0], offset);
+        if (eol == STRING_NPOS)
+            eol = length;
+
+        line_t line;
+        line.text = string_const(str + offset, eol - offset);
+        if (line.text.length > 0 && line.text.str[line.text.length - 1] == '\r')
+            line.text.length--;
+        offset = eol + 1;
+
+        const bool in_hunk = old_remaining > 0 || new_remaining > 0;
+        const char marker = line.text.length > 0 ? line.text.str[0] : ' ';
+
+        if (in_hunk && (marker == ' ' || marker == '-' || marker == '+'))
+        {
+            if (marker != '+') old_remaining--;
+            if (marker != '-') new_remaining--;
+
+            if (marker == '+')
+            {
+                line.type = line_type_t::added;
+                patch.additions++;
+            }
+            else if (marker == '-')
+            {
+                line.type = line_type_t::removed;
+                patch.deletions++;
+            }
+            else
+                line.type = line_type_t::context;
+        }
+        else if (marker == '\\' && !patch.hunks.empty())
+        {
+            line.type = line_type_t::meta;
+        }
+        else if (starts_with(line.text, STRING_CONST("@@")) && !patch.files.empty())
+        {
+            hunk_t hunk;
+            hunk.first_line = patch.lines.size();
+            const char* end = line.text.str + line.text.length;
+            const char* next = parse_range(line.text.str + 2, end, '-', hunk.old_start, hunk.old_count);
+            parse_range(next, end, '+', hunk.new_start, hunk.new_count);
+            patch.hunks.push_back(hunk);
+            patch.files.back().hunk_count++;
+
+            old_remaining = hunk.old_count;
+            new_remaining = hunk.new_count;
+            line.type = line_type_t::hunk;
+        }
+        else
+        {
+            if (starts_with(line.text, STRING_CONST("diff ")) || patch.files.empty())
+            {
+                file_t file;
+                file.first_line = patch.lines.size();
+                file.first_hunk = patch.hunks.size();
+                patch.files.push_back(file);
+            }
+
+            if (starts_with(line.text, STRING_CONST("+++ ")))
+            {
+                string_const_t name = parse_file_name(line.text);
+                if (!string_equal(STRING_ARGS(name), STRING_CONST("/dev/null")))
+                    patch.files.back().name = name;
+            }
+            else if (starts_with(line.text, STRING_CONST("--- ")) && patch.files.back().name.length == 0)
+            {
+                patch.files.back().name = parse_file_name(line.text);
+            }
+
+            old_remaining = new_remaining = 0;
+            line.type = line_type_t::header;
+        }
+
+        line.hunk = patch.hunks.empty() ? 0 : (unsigned)(patch.hunks.size() - 1);
+        if (line.type != line_type_t::header && !patch.hunks.empty())
+            patch.hunks.back().line_count = patch.lines.size() - patch.hunks.back().first_line + 1;
+        patch.lines.push_back(line);
+    }
+
+    update_rows(patch);
+    return patch;
+}
+
+void update_rows(patch_t& patch)
+{
+    patch.rows.resize(0);
+    patch.rows.reserve(patch.lines.size());
+
+    for (size_t i = 0, end = patch.lines.size(); i < end; ++i)
+    {
+        const line_t& line = patch.lines[i];
+        if (line.type != line_type_t::header && line.type != line_type_t::hunk && patch.hunks[line.hunk].folded)
+            continue;
+        patch.rows.push_back(i);
+    }
+}
+
+void toggle_hunk(patch_t& patch, size_t hunk_index)
+{
+    if (hunk_index >= patch.hunks.size())
+        return;
+
+    patch.hunks[hunk_index].folded = !patch.hunks[hunk_index].folded;
+    update_rows(patch);
+}
+
+void finalize(patch_t& patch)
+{
+    patch.files.clear();
+    patch.hunks.clear();
+    patch.lines.clear();
+    patch.rows.clear();
+    patch.additions = patch.deletions = 0;
+}
+
+}}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common.h"
+
+namespace timelapse { namespace patch {
+
+    enum class line_type_t : unsigned char
+    {
+        header,
+        hunk,
+        context,
+        added,
+        removed,
+        meta
+    };
+
+    struct line_t
+    {
+        line_type_t type{};
+        unsigned hunk{};
+        string_const_t text{};
+    };
+
+    struct hunk_t
+    {
+        size_t first_line{};
+        size_t line_count{};
+        int old_start{}, old_count{};
+        int new_start{}, new_count{};
+        bool folded{};
+    };
+
+    struct file_t
+    {
+        string_const_t name{};
+        size_t first_line{};
+        size_t first_hunk{};
+        size_t hunk_count{};
+    };
+
+    struct patch_t
+    {
+        size_t additions{};
+        size_t deletions{};
+
+        generics::vector<file_t> files;
+        generics::vector<hunk_t> hunks;
+        generics::vector<line_t> lines;
+
+        /// Indexes into lines of the rows currently shown (i.e. the lines of folded hunks are skipped).
+        generics::vector<size_t> rows;
+    };
+
+    /// Parse a unified diff into file, hunk and line records. Line texts reference the patch buffer,
+    /// which needs to outlive the returned records.
+    patch_t parse(const char* str, size_t length);
+
+    /// Rebuild the rows to be displayed according to the hunk folding states.
+    void update_rows(patch_t& patch);
+
+    /// Fold or unfold a single hunk and update the displayed rows.
+    void toggle_hunk(patch_t& patch, size_t hunk_index);
+
+    /// Release the records of a parsed patch.
+    void finalize(patch_t& patch);
+
+}}
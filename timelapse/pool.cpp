@@ -0,0 +1,402 @@
+#include "pool.h"
+
+#include "foundation/memory.h"
+#include "foundation/mutex.h"
+#include "foundation/array.h"
+#include "foundation/hash.h"
+#include "foundation/string.h"
+#include "foundation/hashstrings.h"
+
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace pool {
+
+// Ids index pages of records which never move, so records can be read while others get interned.
+const uint32_t PAGE_SHIFT = 14;
+const uint32_t PAGE_SIZE = 1 << PAGE_SHIFT;
+const uint32_t PAGE_MASK = PAGE_SIZE - 1;
+const uint32_t MAX_PAGES = 16384;
+
+// Strings are appended to blocks which never move either, the larger ones get a block of their own.
+const size_t STRING_BLOCK_SIZE = 256 * 1024;
+
+// Lines interned by intern_lines before letting other threads in.
+const size_t LINE_BATCH_SIZE = 256;
+
+const uint32_t MIN_TABLE_CAPACITY = 4096;
+
+struct string_entry_t
+{
+    const char* str;
+    uint32_t length;
+    uint32_t hash;
+};
+
+template <typename T>
+struct records_t
+{
+    T* pages[MAX_PAGES];
+    uint32_t count;
+};
+
+/// Open addressing set of record ids (0 being a free slot), grown past 3/4 load.
+struct table_t
+{
+    uint32_t* slots;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+/// Header of the string blocks, which are chained together to be released on reset.
+struct block_t
+{
+    block_t* next;
+};
+
+/// Everything the pool holds, which gets set aside as a whole while compacting.
+struct content_t
+{
+    records_t<string_entry_t> strings;
+    records_t<line_t> lines;
+    table_t string_table;
+    table_t line_table;
+    block_t* blocks;
+    block_t* large_blocks;
+    size_t block_used;
+    size_t memory;
+};
+
+static mutex_t* g_lock = nullptr;
+static content_t g_content;
+static size_t g_lookups = 0;
+
+/// Interning is short and mostly uncontended, the parse workers only take turns between batches.
+struct scoped_lock_t
+{
+    scoped_lock_t() { mutex_lock(g_lock); }
+    ~scoped_lock_t() { mutex_unlock(g_lock); }
+
+    scoped_lock_t(const scoped_lock_t&) = delete;
+    scoped_lock_t& operator=(const scoped_lock_t&) = delete;
+};
+
+/// Pool memory outlives any arena active on the interning thread.
+static void* allocate(size_t size)
+{
+    g_content.memory += size;
+    return memory_allocate(HASH_TIMELAPSE, size, 0, MEMORY_PERSISTENT | MEMORY_NO_ARENA | MEMORY_ZERO_INITIALIZED);
+}
+
+template <typename T>
+static T& record(records_t<T>& records, uint32_t id)
+{
+    return records.pages[id >> PAGE_SHIFT][id & PAGE_MASK];
+}
+
+/// Returns 0 once all the pages are used, in which case the empty record is used instead.
+template <typename T>
+static uint32_t append_record(records_t<T>& records, const T& value)
+{
+    if (records.count == 0)
+        records.count = 1;
+
+    const uint32_t page = records.count >> PAGE_SHIFT;
+    if (page >= MAX_PAGES)
+        return 0;
+
+    if (!records.pages[page])
+        records.pages[page] = (T*)allocate(PAGE_SIZE * sizeof(T));
+    records.pages[page][records.count & PAGE_MASK] = value;
+    return records.count++;
+}
+
+template <typename T>
+static void release_records(records_t<T>& records)
+{
+    for (uint32_t i = 0; i < MAX_PAGES && records.pages[i]; ++i)
+        memory_deallocate(records.pages[i]);
+    memset(&records, 0, sizeof(records));
+}
+
+static uint32_t string_hash(const char* str, size_t length)
+{
+    return (uint32_t)hash(str, length);
+}
+
+static uint32_t line_hash(const line_t& line)
+{
+    return (uint32_t)hash(&line, sizeof(line));
+}
+
+template <typename T>
+static void grow_table(table_t& table, records_t<T>& records, uint32_t (*record_hash)(const T&))
+{
+    const uint32_t capacity = table.capacity ? table.capacity * 2 : MIN_TABLE_CAPACITY;
+    uint32_t* slots = (uint32_t*)allocate(capacity * sizeof(uint32_t));
+    for (uint32_t i = 0; i < table.capacity; ++i)
+    {
+        const uint32_t id = table.slots[i];
+        if (id == 0)
+            continue;
+
+        uint32_t slot = record_hash(record(records, id)) & (capacity - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = id;
+    }
+
+    if (table.slots)
+    {
+        g_content.memory -= table.capacity * sizeof(uint32_t);
+        memory_deallocate(table.slots);
+    }
+    table.slots = slots;
+    table.capacity = capacity;
+}
+
+static uint32_t string_entry_hash(const string_entry_t& entry)
+{
+    return entry.hash;
+}
+
+static const char* store_string(const char* str, size_t length)
+{
+    const size_t size = length + 1;
+    char* dst = nullptr;
+    if (size > STRING_BLOCK_SIZE / 4)
+    {
+        block_t* block = (block_t*)allocate(sizeof(block_t) + size);
+        block->next = g_content.large_blocks;
+        g_content.large_blocks = block;
+        dst = (char*)(block + 1);
+    }
+    else
+    {
+        // The current block is always the head of the chain.
+        if (!g_content.blocks || g_content.block_used + size > STRING_BLOCK_SIZE)
+        {
+            block_t* block = (block_t*)allocate(sizeof(block_t) + STRING_BLOCK_SIZE);
+            block->next = g_content.blocks;
+            g_content.blocks = block;
+            g_content.block_used = 0;
+        }
+        dst = (char*)(g_content.blocks + 1) + g_content.block_used;
+        g_content.block_used += size;
+    }
+
+    memcpy(dst, str, length);
+    dst[length] = '\0';
+    return dst;
+}
+
+static string_id_t intern_string_locked(const char* str, size_t length)
+{
+    if (length == 0)
+        return 0;
+
+    g_lookups++;
+    if ((g_content.string_table.count + 1) * 4 > g_content.string_table.capacity * 3)
+        grow_table(g_content.string_table, g_content.strings, string_entry_hash);
+
+    const uint32_t h = string_hash(str, length);
+    const uint32_t mask = g_content.string_table.capacity - 1;
+    uint32_t slot = h & mask;
+    while (const uint32_t id = g_content.string_table.slots[slot])
+    {
+        const string_entry_t& entry = record(g_content.strings, id);
+        if (entry.hash == h && entry.length == length && memcmp(entry.str, str, length) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+
+    string_entry_t entry;
+    entry.str = store_string(str, length);
+    entry.length = (uint32_t)length;
+    entry.hash = h;
+    const string_id_t id = append_record(g_content.strings, entry);
+    if (id != 0)
+    {
+        g_content.string_table.slots[slot] = id;
+        g_content.string_table.count++;
+    }
+    return id;
+}
+
+static line_id_t intern_line_locked(const line_t& line)
+{
+    g_lookups++;
+    if ((g_content.line_table.count + 1) * 4 > g_content.line_table.capacity * 3)
+        grow_table(g_content.line_table, g_content.lines, line_hash);
+
+    const uint32_t mask = g_content.line_table.capacity - 1;
+    uint32_t slot = line_hash(line) & mask;
+    while (const uint32_t id = g_content.line_table.slots[slot])
+    {
+        if (memcmp(&record(g_content.lines, id), &line, sizeof(line)) == 0)
+            return id;
+        slot = (slot + 1) & mask;
+    }
+
+    const line_id_t id = append_record(g_content.lines, line);
+    if (id != 0)
+    {
+        g_content.line_table.slots[slot] = id;
+        g_content.line_table.count++;
+    }
+    return id;
+}
+
+string_id_t intern_string(const char* str, size_t length)
+{
+    scoped_lock_t lock;
+    return intern_string_locked(str, length);
+}
+
+string_const_t string(string_id_t id)
+{
+    if (id == 0)
+        return string_empty();
+
+    const string_entry_t& entry = record(g_content.strings, id);
+    return string_const(entry.str, entry.length);
+}
+
+line_id_t intern_line(const line_t& line)
+{
+    scoped_lock_t lock;
+    return intern_line_locked(line);
+}
+
+void intern_lines(const line_fields_t* lines, size_t count, line_id_t* ids)
+{
+    for (size_t begin = 0; begin < count; begin += LINE_BATCH_SIZE)
+    {
+        const size_t end = generics::min(count, begin + LINE_BATCH_SIZE);
+        scoped_lock_t lock;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const line_fields_t& fields = lines[i];
+            line_t line;
+            line.author = intern_string_locked(STRING_ARGS(fields.author));
+            line.rev = intern_string_locked(STRING_ARGS(fields.rev));
+            line.date = intern_string_locked(STRING_ARGS(fields.date));
+            line.code = intern_string_locked(STRING_ARGS(fields.code));
+            line.time = fields.time;
+            ids[i] = intern_line_locked(line);
+        }
+    }
+}
+
+const line_t& line(line_id_t id)
+{
+    static const line_t empty_line;
+    if (id == 0)
+        return empty_line;
+    return record(g_content.lines, id);
+}
+
+static void release_content(content_t& content)
+{
+    release_records(content.strings);
+    release_records(content.lines);
+    memory_deallocate(content.string_table.slots);
+    memory_deallocate(content.line_table.slots);
+
+    block_t* chains[] = { content.blocks, content.large_blocks };
+    for (block_t* block : chains)
+    {
+        while (block)
+        {
+            block_t* next = block->next;
+            memory_deallocate(block);
+            block = next;
+        }
+    }
+    memset(&content, 0, sizeof(content));
+}
+
+static string_id_t intern_string_of(content_t& content, string_id_t id)
+{
+    if (id == 0)
+        return 0;
+
+    const string_entry_t& entry = record(content.strings, id);
+    return intern_string_locked(entry.str, entry.length);
+}
+
+void initialize()
+{
+    if (!g_lock)
+        g_lock = mutex_allocate(STRING_CONST("pool"));
+}
+
+void finalize()
+{
+    if (!g_lock)
+        return;
+
+    reset();
+    mutex_deallocate(g_lock);
+    g_lock = nullptr;
+}
+
+void reset()
+{
+    scoped_lock_t lock;
+    release_content(g_content);
+    g_lookups = 0;
+}
+
+void compact(line_id_t* const* arrays, size_t array_count)
+{
+    scoped_lock_t lock;
+
+    // The previous content is released once the lines still referenced got interned again, each one only once.
+    content_t* previous = (content_t*)memory_allocate(HASH_TIMELAPSE, sizeof(content_t), 0, MEMORY_TEMPORARY | MEMORY_NO_ARENA);
+    memcpy(previous, &g_content, sizeof(content_t));
+    memset(&g_content, 0, sizeof(g_content));
+
+    const size_t previous_count = generics::max((size_t)previous->lines.count, (size_t)1);
+    line_id_t* remap = (line_id_t*)memory_allocate(HASH_TIMELAPSE, previous_count * sizeof(line_id_t), 0,
+        MEMORY_TEMPORARY | MEMORY_NO_ARENA | MEMORY_ZERO_INITIALIZED);
+    for (size_t a = 0; a < array_count; ++a)
+    {
+        line_id_t* ids = arrays[a];
+        for (size_t i = 0, end = array_size(ids); i < end; ++i)
+        {
+            const line_id_t id = ids[i];
+            if (id == 0)
+                continue;
+
+            if (remap[id] == 0)
+            {
+                const line_t& previous_line = record(previous->lines, id);
+                line_t line;
+                line.author = intern_string_of(*previous, previous_line.author);
+                line.rev = intern_string_of(*previous, previous_line.rev);
+                line.date = intern_string_of(*previous, previous_line.date);
+                line.code = intern_string_of(*previous, previous_line.code);
+                line.time = previous_line.time;
+                remap[id] = intern_line_locked(line);
+            }
+            ids[i] = remap[id];
+        }
+    }
+
+    memory_deallocate(remap);
+    release_content(*previous);
+    memory_deallocate(previous);
+}
+
+stats_t stats()
+{
+    scoped_lock_t lock;
+    stats_t stats;
+    stats.strings = g_content.strings.count > 0 ? g_content.strings.count - 1 : 0;
+    stats.lines = g_content.lines.count > 0 ? g_content.lines.count - 1 : 0;
+    stats.lookups = g_lookups;
+    stats.memory = g_content.memory;
+    return stats;
+}
+
+}}
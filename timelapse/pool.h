@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.h"
+
+namespace timelapse { namespace pool {
+
+    /// Store of the annotated lines shared by all the revisions: consecutive revisions of a file have most of their
+    /// lines in common, so each distinct string and each distinct annotated line is only kept once, and revisions
+    /// only hold line ids. Equal strings or lines always get the same id, which makes their comparison an integer one.
+    /// Interning can be done from any thread, while reading an id only requires it to be handed over from the
+    /// thread which interned it (i.e. through a completed scm request). Id 0 is the empty string and the empty line.
+    typedef uint32_t string_id_t;
+    typedef uint32_t line_id_t;
+
+    struct line_t
+    {
+        string_id_t author{};
+        string_id_t rev{};
+        string_id_t date{};
+        string_id_t code{};
+        time_t time{};
+    };
+
+    /// Annotated line fields referencing the scm output they got parsed from, see intern_lines.
+    struct line_fields_t
+    {
+        string_const_t author{};
+        string_const_t rev{};
+        string_const_t date{};
+        string_const_t code{};
+        time_t time{};
+    };
+
+    /// Allocates the pool lock, once per process before anything gets interned (see main_initialize).
+    void initialize();
+
+    /// Releases every string and line, along with the pool lock.
+    void finalize();
+
+    string_id_t intern_string(const char* str, size_t length);
+
+    /// Returns an interned string, which stays valid (and zero terminated) until the pool gets reset or compacted.
+    string_const_t string(string_id_t id);
+
+    line_id_t intern_line(const line_t& line);
+
+    /// Interns a batch of lines at once, which only locks the pool once.
+    void intern_lines(const line_fields_t* lines, size_t count, line_id_t* ids);
+
+    const line_t& line(line_id_t id);
+
+    /// Releases every string and line, which must no longer be referenced by anything.
+    void reset();
+
+    /// Keeps only the lines referenced by the given arrays of line ids (see foundation/array.h), whose ids get replaced
+    /// in place, and releases everything else (i.e. the lines of the compressed revisions). Nothing else may reference
+    /// an id, nor intern anything, until it returns.
+    void compact(line_id_t* const* arrays, size_t array_count);
+
+    /// Counters of the pool content, used by the diagnostics overlay.
+    struct stats_t
+    {
+        size_t strings{};
+        size_t lines{};
+        size_t lookups{};
+        size_t memory{};
+    };
+
+    stats_t stats();
+
+}}
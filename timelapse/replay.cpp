@@ -0,0 +1,456 @@
+#include "replay.h"
+
+#include "foundation/stream.h"
+#include "foundation/mutex.h"
+#include "foundation/thread.h"
+#include "foundation/string.h"
+#include "foundation/log.h"
+#include "foundation/hashstrings.h"
+
+#include <imgui/imgui.h>
+
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace replay {
+
+// Trace file header, followed by the frame and command records in the order they were written
+const uint32_t TRACE_MAGIC = 0x50524C54; // "TLRP"
+const uint32_t TRACE_VERSION = 1;
+const uint8_t RECORD_FRAME = 1;
+const uint8_t RECORD_COMMAND = 2;
+
+const int MOUSE_BUTTON_COUNT = IM_ARRAYSIZE(ImGuiIO::MouseDown);
+const int KEY_COUNT = IM_ARRAYSIZE(ImGuiIO::KeysDown);
+const int INPUT_CHARACTER_COUNT = IM_ARRAYSIZE(ImGuiIO::InputCharacters) - 1;
+
+enum modifier_t : uint8_t
+{
+    MODIFIER_CTRL = 1 << 0,
+    MODIFIER_SHIFT = 1 << 1,
+    MODIFIER_ALT = 1 << 2,
+    MODIFIER_SUPER = 1 << 3
+};
+
+struct frame_record_t
+{
+    deltatime_t time{};
+    float delta_time{};
+    ImVec2 display_size{};
+    ImVec2 mouse_pos{};
+    float mouse_wheel{};
+    float mouse_wheel_h{};
+    uint8_t mouse_buttons{};
+    uint8_t modifiers{};
+    uint8_t keys[KEY_COUNT / 8]{};
+    ImWchar characters[INPUT_CHARACTER_COUNT + 1]{};
+    string_t open_file{};
+};
+
+struct command_record_t
+{
+    deltatime_t elapsed{};
+    unsigned exit_code{};
+    string_t arguments{};
+    string_t output{};
+    bool replayed{};
+};
+
+// Recording, the frames are written by the main thread and the commands by the scm workers
+static stream_t* g_stream = nullptr;
+static mutex_t* g_mutex = nullptr;
+static tick_t g_start = 0;
+static string_t g_pending_open{};
+
+// Replay, only the replayed flags of the commands change once the trace is loaded
+static bool g_replaying = false;
+static generics::vector<frame_record_t> g_frames;
+static generics::vector<command_record_t> g_commands;
+static size_t g_next_frame = 0;
+static size_t g_first_pending_command = 0;
+static const frame_record_t* g_current_frame = nullptr;
+static size_t g_replayed_commands = 0;
+static size_t g_missing_commands = 0;
+
+static void write_string(stream_t* stream, const char* str, size_t length)
+{
+    stream_write_uint64(stream, length);
+    if (length > 0)
+        stream_write(stream, str, length);
+}
+
+static size_t remaining_size(stream_t* stream)
+{
+    return stream_size(stream) - stream_tell(stream);
+}
+
+static bool read_string(stream_t* stream, string_t& str)
+{
+    // A truncated trace (i.e. the recorded session crashed) ends in the middle of a record.
+    str = {0, 0};
+    if (remaining_size(stream) < sizeof(uint64_t))
+        return false;
+
+    const size_t length = (size_t)stream_read_uint64(stream);
+    if (length > remaining_size(stream))
+        return false;
+    if (length == 0)
+        return true;
+
+    str = string_allocate(length, length + 1);
+    return stream_read(stream, str.str, length) == length;
+}
+
+static void write_header(stream_t* stream)
+{
+    const ImGuiIO& io = ImGui::GetIO();
+    stream_write_uint32(stream, TRACE_MAGIC);
+    stream_write_uint32(stream, TRACE_VERSION);
+    stream_write_int32(stream, io.ConfigFlags);
+
+    // The key indexes are the ones of the recording backend, replaying needs the same mapping.
+    stream_write_int32(stream, ImGuiKey_COUNT);
+    for (int i = 0; i < ImGuiKey_COUNT; ++i)
+        stream_write_int32(stream, io.KeyMap[i]);
+}
+
+static bool read_header(stream_t* stream)
+{
+    if (stream_read_uint32(stream) != TRACE_MAGIC || stream_read_uint32(stream) != TRACE_VERSION)
+        return false;
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.ConfigFlags = stream_read_int32(stream);
+
+    const int key_count = stream_read_int32(stream);
+    for (int i = 0; i < key_count; ++i)
+    {
+        const int key = stream_read_int32(stream);
+        if (i < ImGuiKey_COUNT)
+            io.KeyMap[i] = key;
+    }
+
+    return true;
+}
+
+static bool read_frame(stream_t* stream, frame_record_t& frame)
+{
+    frame.time = stream_read_float64(stream);
+    frame.delta_time = stream_read_float32(stream);
+    frame.display_size.x = stream_read_float32(stream);
+    frame.display_size.y = stream_read_float32(stream);
+    frame.mouse_pos.x = stream_read_float32(stream);
+    frame.mouse_pos.y = stream_read_float32(stream);
+    frame.mouse_wheel = stream_read_float32(stream);
+    frame.mouse_wheel_h = stream_read_float32(stream);
+    frame.mouse_buttons = stream_read_uint8(stream);
+    frame.modifiers = stream_read_uint8(stream);
+    if (stream_read(stream, frame.keys, sizeof(frame.keys)) != sizeof(frame.keys))
+        return false;
+
+    const int character_count = generics::min((int)stream_read_uint8(stream), INPUT_CHARACTER_COUNT);
+    for (int i = 0; i < character_count; ++i)
+        frame.characters[i] = (ImWchar)stream_read_uint16(stream);
+    frame.characters[character_count] = 0;
+
+    return read_string(stream, frame.open_file);
+}
+
+static bool read_command(stream_t* stream, command_record_t& command)
+{
+    command.elapsed = stream_read_float64(stream);
+    command.exit_code = stream_read_uint32(stream);
+    if (!read_string(stream, command.arguments))
+        return false;
+    return read_string(stream, command.output);
+}
+
+bool start_recording(const char* path, size_t length)
+{
+    if (g_stream || g_replaying)
+        return false;
+
+    g_stream = stream_open(path, length, STREAM_OUT | STREAM_BINARY | STREAM_CREATE | STREAM_TRUNCATE);
+    if (!g_stream)
+    {
+        log_warnf(HASH_TIMELAPSE, WARNING_RESOURCE, STRING_CONST("Failed to create trace file %.*s"), (int)length, path);
+        return false;
+    }
+
+    g_mutex = mutex_allocate(STRING_CONST("replay"));
+    g_start = time_current();
+    write_header(g_stream);
+
+    log_infof(HASH_TIMELAPSE, STRING_CONST("Recording session to %.*s"), (int)length, path);
+    return true;
+}
+
+bool start_replay(const char* path, size_t length)
+{
+    if (g_stream || g_replaying)
+        return false;
+
+    stream_t* stream = stream_open(path, length, STREAM_IN | STREAM_BINARY);
+    if (!stream || !read_header(stream))
+    {
+        log_warnf(HASH_TIMELAPSE, WARNING_INVALID_VALUE, STRING_CONST("Invalid trace file %.*s"), (int)length, path);
+        stream_deallocate(stream);
+        return false;
+    }
+
+    bool truncated = false;
+    while (!truncated && remaining_size(stream) > 0)
+    {
+        const uint8_t type = stream_read_uint8(stream);
+        if (type == RECORD_FRAME)
+        {
+            frame_record_t frame;
+            truncated = !read_frame(stream, frame);
+            if (!truncated)
+                g_frames.push_back(frame);
+            else
+                string_deallocate(frame.open_file.str);
+        }
+        else if (type == RECORD_COMMAND)
+        {
+            command_record_t command;
+            truncated = !read_command(stream, command);
+            if (!truncated)
+                g_commands.push_back(command);
+            else
+            {
+                string_deallocate(command.arguments.str);
+                string_deallocate(command.output.str);
+            }
+        }
+        else
+        {
+            truncated = true;
+        }
+    }
+    stream_deallocate(stream);
+
+    if (truncated)
+        log_warnf(HASH_TIMELAPSE, WARNING_INVALID_VALUE, STRING_CONST("Trace file %.*s is truncated, replaying what could be read"), (int)length, path);
+
+    g_mutex = mutex_allocate(STRING_CONST("replay"));
+    g_start = time_current();
+    g_replaying = true;
+
+    log_infof(HASH_TIMELAPSE, STRING_CONST("Replaying %" PRIsize " frames and %" PRIsize " scm commands from %.*s"),
+        g_frames.size(), g_commands.size(), (int)length, path);
+    return true;
+}
+
+void stop()
+{
+    stream_deallocate(g_stream);
+    g_stream = nullptr;
+    string_deallocate(g_pending_open.str);
+    g_pending_open = {};
+
+    for (auto& frame : g_frames)
+        string_deallocate(frame.open_file.str);
+    g_frames.clear();
+    for (auto& command : g_commands)
+    {
+        string_deallocate(command.arguments.str);
+        string_deallocate(command.output.str);
+    }
+    g_commands.clear();
+
+    g_replaying = false;
+    g_next_frame = 0;
+    g_first_pending_command = 0;
+    g_current_frame = nullptr;
+    g_replayed_commands = 0;
+    g_missing_commands = 0;
+
+    mutex_deallocate(g_mutex);
+    g_mutex = nullptr;
+}
+
+bool is_recording()
+{
+    return g_stream != nullptr;
+}
+
+bool is_replaying()
+{
+    return g_replaying;
+}
+
+void record_frame()
+{
+    if (!g_stream)
+        return;
+
+    const ImGuiIO& io = ImGui::GetIO();
+
+    uint8_t mouse_buttons = 0;
+    for (int i = 0; i < MOUSE_BUTTON_COUNT; ++i)
+        mouse_buttons |= io.MouseDown[i] ? (uint8_t)(1 << i) : 0;
+
+    uint8_t modifiers = 0;
+    modifiers |= io.KeyCtrl ? MODIFIER_CTRL : 0;
+    modifiers |= io.KeyShift ? MODIFIER_SHIFT : 0;
+    modifiers |= io.KeyAlt ? MODIFIER_ALT : 0;
+    modifiers |= io.KeySuper ? MODIFIER_SUPER : 0;
+
+    uint8_t keys[KEY_COUNT / 8] = {};
+    for (int i = 0; i < KEY_COUNT; ++i)
+        keys[i / 8] |= io.KeysDown[i] ? (uint8_t)(1 << (i % 8)) : 0;
+
+    int character_count = 0;
+    while (character_count < INPUT_CHARACTER_COUNT && io.InputCharacters[character_count] != 0)
+        ++character_count;
+
+    mutex_lock(g_mutex);
+    stream_write_uint8(g_stream, RECORD_FRAME);
+    stream_write_float64(g_stream, time_elapsed(g_start));
+    stream_write_float32(g_stream, io.DeltaTime);
+    stream_write_float32(g_stream, io.DisplaySize.x);
+    stream_write_float32(g_stream, io.DisplaySize.y);
+    stream_write_float32(g_stream, io.MousePos.x);
+    stream_write_float32(g_stream, io.MousePos.y);
+    stream_write_float32(g_stream, io.MouseWheel);
+    stream_write_float32(g_stream, io.MouseWheelH);
+    stream_write_uint8(g_stream, mouse_buttons);
+    stream_write_uint8(g_stream, modifiers);
+    stream_write(g_stream, keys, sizeof(keys));
+    stream_write_uint8(g_stream, (uint8_t)character_count);
+    for (int i = 0; i < character_count; ++i)
+        stream_write_uint16(g_stream, io.InputCharacters[i]);
+    write_string(g_stream, STRING_ARGS(g_pending_open));
+
+    // Keep the trace usable if the session ends up crashing.
+    stream_flush(g_stream);
+    mutex_unlock(g_mutex);
+
+    string_deallocate(g_pending_open.str);
+    g_pending_open = {};
+}
+
+void record_open(const char* file_path)
+{
+    if (!g_stream)
+        return;
+
+    string_deallocate(g_pending_open.str);
+    g_pending_open = string_clone(file_path, strlen(file_path));
+}
+
+void record_command(const char* arguments, size_t length, const string_t& output, unsigned exit_code, deltatime_t elapsed)
+{
+    if (!g_stream)
+        return;
+
+    mutex_lock(g_mutex);
+    stream_write_uint8(g_stream, RECORD_COMMAND);
+    stream_write_float64(g_stream, elapsed);
+    stream_write_uint32(g_stream, exit_code);
+    write_string(g_stream, arguments, length);
+    write_string(g_stream, STRING_ARGS(output));
+    mutex_unlock(g_mutex);
+}
+
+bool replay_command(const char* arguments, size_t length, string_t& output, unsigned& exit_code)
+{
+    if (!g_replaying)
+        return false;
+
+    // Identical commands are replayed in the order they were recorded.
+    const command_record_t* record = nullptr;
+    mutex_lock(g_mutex);
+    while (g_first_pending_command < g_commands.size() && g_commands[g_first_pending_command].replayed)
+        ++g_first_pending_command;
+    for (size_t i = g_first_pending_command, end = g_commands.size(); i < end && !record; ++i)
+    {
+        command_record_t& command = g_commands[i];
+        if (!command.replayed && string_equal(STRING_ARGS(command.arguments), arguments, length))
+        {
+            command.replayed = true;
+            record = &command;
+        }
+    }
+    if (record)
+        ++g_replayed_commands;
+    else
+        ++g_missing_commands;
+    mutex_unlock(g_mutex);
+
+    if (!record)
+    {
+        // It had not completed by the end of the trace (or was never issued), fail the request right away
+        // instead of keeping the worker busy until the request gets disposed.
+        log_warnf(HASH_TIMELAPSE, WARNING_INVALID_VALUE, STRING_CONST("Command not found in trace: %.*s"), (int)length, arguments);
+        output = {0, 0};
+        exit_code = 1;
+        return true;
+    }
+
+    // Take as long as the recorded command, unless the request gets disposed meanwhile.
+    thread_try_wait((unsigned)(record->elapsed * 1000.0));
+
+    output = string_clone(STRING_ARGS(record->output));
+    exit_code = record->exit_code;
+    return true;
+}
+
+bool next_frame()
+{
+    g_current_frame = nullptr;
+    if (!g_replaying || g_next_frame >= g_frames.size())
+        return false;
+
+    // Frames start at the recorded times, so the scm commands complete around the same frames.
+    const frame_record_t& frame = g_frames[g_next_frame++];
+    const deltatime_t wait = frame.time - time_elapsed(g_start);
+    if (wait > 0)
+        thread_sleep((unsigned)(wait * 1000.0));
+
+    ImGuiIO& io = ImGui::GetIO();
+    io.DeltaTime = frame.delta_time;
+    io.DisplaySize = frame.display_size;
+    io.MousePos = frame.mouse_pos;
+    io.MouseWheel = frame.mouse_wheel;
+    io.MouseWheelH = frame.mouse_wheel_h;
+    for (int i = 0; i < MOUSE_BUTTON_COUNT; ++i)
+        io.MouseDown[i] = (frame.mouse_buttons & (1 << i)) != 0;
+
+    io.KeyCtrl = (frame.modifiers & MODIFIER_CTRL) != 0;
+    io.KeyShift = (frame.modifiers & MODIFIER_SHIFT) != 0;
+    io.KeyAlt = (frame.modifiers & MODIFIER_ALT) != 0;
+    io.KeySuper = (frame.modifiers & MODIFIER_SUPER) != 0;
+    for (int i = 0; i < KEY_COUNT; ++i)
+        io.KeysDown[i] = (frame.keys[i / 8] & (1 << (i % 8))) != 0;
+
+    memcpy(io.InputCharacters, frame.characters, sizeof(frame.characters));
+
+    g_current_frame = &frame;
+    return true;
+}
+
+string_const_t opened_file()
+{
+    if (!g_current_frame)
+        return string_const(nullptr, 0);
+    return string_to_const(g_current_frame->open_file);
+}
+
+stats_t stats()
+{
+    stats_t stats;
+    stats.frame_count = g_frames.size();
+    stats.replayed_frames = g_next_frame;
+    stats.command_count = g_commands.size();
+    if (!g_replaying)
+        return stats;
+
+    mutex_lock(g_mutex);
+    stats.replayed_commands = g_replayed_commands;
+    stats.missing_commands = g_missing_commands;
+    mutex_unlock(g_mutex);
+    return stats;
+}
+
+}}
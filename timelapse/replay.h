@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.h"
+
+#include "foundation/time.h"
+
+namespace timelapse { namespace replay {
+
+    /// Starts recording the scm commands, with their output and timing, and the ImGui input of each
+    /// frame to a trace file. Must be called once the ImGui context has been setup.
+    bool start_recording(const char* path, size_t length);
+
+    /// Loads a trace file, the scm commands get their output from the trace instead of spawning any
+    /// process, and next_frame feeds the recorded input. Must be called once the ImGui context has been setup.
+    bool start_replay(const char* path, size_t length);
+
+    /// Closes the trace being recorded or releases the trace being replayed, once the scm requests have been disposed.
+    void stop();
+
+    bool is_recording();
+    bool is_replaying();
+
+    /// Writes the input of the current frame, called right after ImGui::NewFrame.
+    void record_frame();
+
+    /// Records a file being opened, it gets opened again at the start of the same frame when replaying.
+    void record_open(const char* file_path);
+
+    /// Records the output of a scm command given its arguments, called from the worker thread once the process exited.
+    void record_command(const char* arguments, size_t length, const string_t& output, unsigned exit_code, deltatime_t elapsed);
+
+    /// Gives the recorded output of a scm command matching the arguments when replaying, after waiting as long as the command took.
+    /// Commands missing from the trace fail right away.
+    /// Returns false if not replaying, in which case the command needs to be executed.
+    bool replay_command(const char* arguments, size_t length, string_t& output, unsigned& exit_code);
+
+    /// Waits for the time of the next recorded frame and sets its input on the ImGui IO, to be called
+    /// before ImGui::NewFrame. Returns false once all the frames have been replayed.
+    bool next_frame();
+
+    /// Returns the file opened in the frame being replayed, if any.
+    string_const_t opened_file();
+
+    /// Counters of the trace being replayed.
+    struct stats_t
+    {
+        size_t frame_count{};
+        size_t replayed_frames{};
+        size_t command_count{};
+        size_t replayed_commands{};
+        size_t missing_commands{};
+    };
+
+    stats_t stats();
+
+}}
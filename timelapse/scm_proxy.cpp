@@ -1,46 +1,127 @@
 #include "scm_proxy.h"
 #include "scoped_string.h"
+#include "replay.h"
+#include "cache.h"
 #include "common.h"
 
-#include "foundation/windows.h"
-#undef THREAD_PRIORITY_HIGHEST
+#if FOUNDATION_PLATFORM_WINDOWS
+    #include "foundation/windows.h"
+    #undef THREAD_PRIORITY_HIGHEST
+#endif
 
 #include "foundation/environment.h"
 #include "foundation/string.h"
 #include "foundation/thread.h"
+#include "foundation/atomic.h"
 #include "foundation/memory.h"
 #include "foundation/hash.h"
 #include "foundation/beacon.h"
 #include "foundation/array.h"
 #include "foundation/log.h"
+#include "foundation/job.h"
+#include "foundation/lz.h"
+
+#include <algorithm>
 
 #define SCM_ARRAYSIZE(_ARR) ((size_t)(sizeof(_ARR)/sizeof(*(_ARR))))
 #define HASH_SCM (static_hash_string("scm", 3, 3754008690416994104ULL))
 
+// Large annotate outputs get parsed in chunks of at least that size on the job workers.
+const size_t ANNOTATIONS_CHUNK_MIN_SIZE = 1024 * 1024;
+const size_t MAX_ANNOTATIONS_CHUNKS = 32;
+const size_t ANNOTATIONS_BATCH_SIZE = 256;
+// Room left in the revision arena for the alignment and terminators of its allocations.
+const size_t ANNOTATIONS_ARENA_SLACK = 256;
+
+using namespace timelapse;
+
+struct revision_order_key_t
+{
+    unsigned index;
+    int id;
+    char date[32];
+    char merged_date[32];
+};
+
 struct command_t
 {
     int context{};
+    thread_fn fn{};
     string_t line{};
     string_t file{};
     string_t dir{};
+    // Changeset hash of the revision, which unlike its id does not change with strip, rebase or pull.
+    string_t node{};
 
     thread_t* thread{};
+    atomic32_t completed;
+    bool started{};
+    bool popped{};
+    bool disposed{};
+    command_t* next{};
 
     unsigned exit_code;
     string_t* results{};
+
+    // Parsed results, produced by the worker thread
+    memory_arena_t* arena{};
+    generics::vector<scm::revision_t> revisions;
+    scm::annotations_t annotations;
+
+    // Revision sort keys and resulting order
+    generics::vector<revision_order_key_t> order_keys;
+    generics::vector<unsigned> order;
 };
 
+static scm::request_completed_handler_t g_request_completed_handler = nullptr;
+static generics::mpsc_queue<command_t> g_completed_commands;
+
+// Diagnostics counters
+static atomic32_t g_running_requests;
+static atomic32_t g_queued_requests;
+static atomic32_t g_running_processes;
+static atomic32_t g_spawned_processes;
+
+// Scm executable invoked by the commands
+static char g_executable[BUILD_MAX_PATHLEN] = "hg";
+
+// Background sessions (i.e. cache pre-warming) only use the cpu time left by everything else.
+static bool g_low_priority = false;
+
+static void* execute_request(void* arg)
+{
+    command_t* cmd = (command_t*)arg;
+    void* result = nullptr;
+    {
+        PROFILE_SCOPE("scm request");
+        result = cmd->fn(cmd);
+    }
+    atomic_store32(&cmd->completed, 1, memory_order_release);
+    atomic_incr32(&g_queued_requests, memory_order_relaxed);
+    atomic_decr32(&g_running_requests, memory_order_relaxed);
+    g_completed_commands.push(cmd);
+
+    // Let the main loop know it has something new to process.
+    if (g_request_completed_handler)
+        g_request_completed_handler();
+
+    return result;
+}
+
 static command_t* command_allocate(int id, const char* file_path, const char* working_dir, thread_fn fn)
 {
-    command_t* cmd = (command_t*)memory_allocate(HASH_SCM, sizeof command_t, 0, 0);
+    command_t* cmd = (command_t*)memory_allocate(HASH_SCM, sizeof command_t, 0, MEMORY_ZERO_INITIALIZED);
     cmd->context = id;
+    cmd->fn = fn;
+    atomic_store32(&cmd->completed, 0, memory_order_relaxed);
     
     cmd->line = { 0,0 };
     cmd->file = string_clone(file_path, strlen(file_path));
     cmd->dir = string_clone(working_dir, strlen(working_dir));
 
-    cmd->thread = thread_allocate(fn, cmd, STRING_CONST("scm command"), THREAD_PRIORITY_HIGHEST, 0);
+    cmd->thread = thread_allocate(execute_request, cmd, STRING_CONST("scm command"), g_low_priority ? THREAD_PRIORITY_LOW : THREAD_PRIORITY_HIGHEST, 0);
     cmd->results = nullptr;
+    scm::annotations_initialize(cmd->annotations);
 
     return cmd;
 }
@@ -55,7 +136,15 @@ static bool command_execute(command_t* cmd, const char* format, size_t length, .
         va_end(list);
     }
 
-    return thread_start(cmd->thread);
+    atomic_incr32(&g_running_requests, memory_order_relaxed);
+    if (thread_start(cmd->thread))
+    {
+        cmd->started = true;
+        return true;
+    }
+
+    atomic_decr32(&g_running_requests, memory_order_relaxed);
+    return false;
 }
 
 static void command_deallocate(command_t* cmd)
@@ -65,16 +154,27 @@ static void command_deallocate(command_t* cmd)
     string_deallocate(cmd->line.str);
     string_deallocate(cmd->dir.str);
     string_deallocate(cmd->file.str);
+    string_deallocate(cmd->node.str);
 
     if (cmd->results)
     {
         string_array_deallocate(cmd->results);
     }
 
+    for (auto& rev : cmd->revisions)
+        scm::revision_deallocate(rev);
+    cmd->revisions.clear();
+    memory_arena_deallocate(cmd->arena);
+    scm::annotations_finailze(cmd->annotations);
+    cmd->order_keys.clear();
+    cmd->order.clear();
+
     memory_deallocate(cmd);
 }
 
-static string_t execute_command(const char* cmd, const char* working_directory, unsigned& exit_code)
+#if FOUNDATION_PLATFORM_WINDOWS
+
+static string_t spawn_command(const char* cmd, const char* working_directory, unsigned& exit_code)
 {
     SECURITY_ATTRIBUTES saAttr;
     saAttr.nLength = sizeof(SECURITY_ATTRIBUTES);
@@ -95,7 +195,7 @@ static string_t execute_command(const char* cmd, const char* working_directory,
     si.wShowWindow = SW_HIDE;
 
     PROCESS_INFORMATION pi = { nullptr, nullptr, 0, 0 };
-    if (!CreateProcessA(nullptr, (LPSTR)cmd, nullptr, nullptr, TRUE, CREATE_NEW_CONSOLE | HIGH_PRIORITY_CLASS, nullptr,
+    if (!CreateProcessA(nullptr, (LPSTR)cmd, nullptr, nullptr, TRUE, CREATE_NEW_CONSOLE | (g_low_priority ? IDLE_PRIORITY_CLASS : HIGH_PRIORITY_CLASS), nullptr,
         working_directory ? working_directory : environment_current_working_directory().str, &si, &pi))
     {
         CloseHandle(hPipeWrite);
@@ -103,6 +203,9 @@ static string_t execute_command(const char* cmd, const char* working_directory,
         return {0, 0};
     }
 
+    atomic_incr32(&g_running_processes, memory_order_relaxed);
+    atomic_incr32(&g_spawned_processes, memory_order_relaxed);
+
     string_t output = {0, 0};
     bool process_ended = false;
     while(!process_ended)
@@ -145,35 +248,97 @@ static string_t execute_command(const char* cmd, const char* working_directory,
     CloseHandle(hPipeRead);
     CloseHandle(pi.hProcess);
     CloseHandle(pi.hThread);
+    atomic_decr32(&g_running_processes, memory_order_relaxed);
+    return output;
+}
+
+#else
+
+// Scm processes only get spawned on Windows, other platforms get the command outputs from a replayed trace.
+static string_t spawn_command(const char* cmd, const char* working_directory, unsigned& exit_code)
+{
+    FOUNDATION_UNUSED(working_directory);
+    log_errorf(HASH_SCM, ERROR_UNSUPPORTED, STRING_CONST("Cannot spawn scm commands on this platform: %s"), cmd);
+    exit_code = PROCESS_SYSTEM_CALL_FAILED;
+    return {0, 0};
+}
+
+#endif
+
+static string_const_t command_arguments(const char* cmd)
+{
+    // All the commands start with the quoted executable, followed by a space.
+    const size_t length = strlen(cmd);
+    const size_t executable_length = strlen(g_executable) + 3;
+    if (length < executable_length)
+        return string_const(cmd, length);
+    return string_const(cmd + executable_length, length - executable_length);
+}
+
+/// Runs a scm command and returns its output. Commands flagged as cached always give the same
+/// output once they succeed, which then gets stored in the cache shared by all sessions.
+static string_t execute_command(const char* cmd, const char* working_directory, unsigned& exit_code, bool cached = false)
+{
+    PROFILE_SCOPE("scm execute command");
+
+    // Replayed sessions get the command outputs from their trace, nothing gets spawned. Commands are
+    // recorded without the executable, which is specific to the recording machine.
+    string_t output;
+    const string_const_t arguments = command_arguments(cmd);
+    if (replay::replay_command(STRING_ARGS(arguments), output, exit_code))
+        return output;
+
+    const tick_t start = time_current();
+    if (cached && cache::read(working_directory, STRING_ARGS(arguments), output))
+    {
+        exit_code = 0;
+    }
+    else
+    {
+        output = spawn_command(cmd, working_directory, exit_code);
+        if (cached && exit_code == 0 && output.length > 0)
+            cache::write(working_directory, STRING_ARGS(arguments), output);
+    }
+    replay::record_command(STRING_ARGS(arguments), output, exit_code, time_elapsed(start));
     return output;
 }
 
-static void* execute_cmd_line_request(void *arg)
+static void* execute_revisions_request(void *arg)
 {
     command_t* cmd = (command_t*)arg;
     scoped_string_t output = execute_command(cmd->line.str, cmd->dir.str, cmd->exit_code);
 
     if (cmd->exit_code != 0)
         return (void*)(size_t)cmd->exit_code;
-    
-    lines_t lines = string_split_lines(STRING_ARGS(output.value));
-    for (size_t i = 0; i < lines.count; ++i)
-        array_push(cmd->results, string_clone(STRING_ARGS(lines[i])));
-    string_lines_finalize(lines);
+
+    {
+        PROFILE_SCOPE("scm parse revisions");
+        lines_t lines = string_split_lines(STRING_ARGS(output.value));
+        {
+            // All the revision info strings get released at once with the revision list.
+            cmd->arena = memory_arena_allocate(HASH_SCM, lines.count * 64);
+            scoped_arena_t scope(cmd->arena);
+            cmd->revisions = scm::revision_list(lines.items, lines.count);
+        }
+        string_lines_finalize(lines);
+    }
+
+    PROFILE_SCOPE("scm sort revisions");
+    std::sort(cmd->revisions.begin(), cmd->revisions.end(), scm::revision_compare);
 
     return 0;
 }
 
-static void* execute_annotations_request(void *arg)
+static void* execute_annotations_commands(command_t* cmd)
 {
-    command_t* cmd = (command_t*)arg;
-
     // TODO: Add option to ignore whitespaces
     // TODO annotate -d -q to have short dates
-    
+
+    // The outputs get cached by command line, so the revision is given by its changeset hash.
     {
-        scoped_string_t annotate = string_allocate_format(STRING_CONST("hg annotate --user -d -q -a -c -r %d \"%s\""), cmd->context, cmd->file.str);
-        scoped_string_t output = execute_command(annotate, cmd->dir.str, cmd->exit_code);
+        PROFILE_SCOPE("scm annotate");
+        scoped_string_t annotate = string_allocate_format(STRING_CONST("\"%s\" annotate --user -d -q -a -c -r %s \"%s\""), g_executable, cmd->node.str, cmd->file.str);
+        scoped_string_t output = execute_command(annotate, cmd->dir.str, cmd->exit_code, true);
         if (cmd->exit_code != 0)
             return (void*)(size_t)cmd->exit_code;
 
@@ -182,9 +347,11 @@ static void* execute_annotations_request(void *arg)
 
     {
         // TODO: Add a flag/option to change the trunk common base
-        //      NOTE: -r \"min(descendants(%d) and branch(parents(min(branch(%d)))))\"";
-        scoped_string_t base_revision_log = string_allocate_format(STRING_CONST("hg log --template \"{date|isodate}|{desc|strip|firstline}\" -r \"min(descendants(%d) and branch(trunk))\""), cmd->context);
-        scoped_string_t output = execute_command(base_revision_log, cmd->dir.str, cmd->exit_code);
+        //      NOTE: -r \"min(descendants(%s) and branch(parents(min(branch(%s)))))\"";
+        PROFILE_SCOPE("scm base revision log");
+        scoped_string_t base_revision_log = string_allocate_format(STRING_CONST("\"%s\" log --template \"{date|isodate}|{desc|strip|firstline}\" -r \"min(descendants(%s) and branch(trunk))\""), g_executable, cmd->node.str);
+        // Only cached once merged in trunk (i.e. not empty), until then the next sessions ask again.
+        scoped_string_t output = execute_command(base_revision_log, cmd->dir.str, cmd->exit_code, true);
         if (cmd->exit_code != 0)
             return (void*)(size_t)cmd->exit_code;
 
@@ -196,8 +363,9 @@ static void* execute_annotations_request(void *arg)
     }
     
     {
-        scoped_string_t patch = string_allocate_format(STRING_CONST("hg diff -c %d -- \"%s\""), cmd->context, cmd->file.str);
-        scoped_string_t output = execute_command(patch, cmd->dir.str, cmd->exit_code);
+        PROFILE_SCOPE("scm diff");
+        scoped_string_t patch = string_allocate_format(STRING_CONST("\"%s\" diff -c %s -- \"%s\""), g_executable, cmd->node.str, cmd->file.str);
+        scoped_string_t output = execute_command(patch, cmd->dir.str, cmd->exit_code, true);
         if (cmd->exit_code != 0)
             return (void*)(size_t)cmd->exit_code;
 
@@ -207,18 +375,222 @@ static void* execute_annotations_request(void *arg)
     return 0;
 }
 
-timelapse::scm::request_t timelapse::scm::fetch_revisions(const char* file_path, const char* working_dir, bool wants_merges)
+static void* execute_parent_revision_request(void* arg)
+{
+    command_t* cmd = (command_t*)arg;
+    scoped_string_t output = execute_command(cmd->line.str, cmd->dir.str, cmd->exit_code);
+
+    // Only the first parent is kept while merging, the file has one annotation per line either way.
+    cmd->context = cmd->exit_code == 0 && output.value.length > 0 ? string_to_int(STRING_ARGS(output.value)) : -1;
+    return (void*)(size_t)cmd->exit_code;
+}
+
+static pool::line_fields_t parse_annotation(string_const_t line)
+{
+    pool::line_fields_t ann;
+
+    // i.e. "  author rev date: code", the code is kept without the separator space nor the line ending, like
+    // the working copy lines, so the same line always ends up with the same id.
+    string_const_t infos_raw;
+    string_split(STRING_ARGS(line), STRING_CONST(":"), &infos_raw, &ann.code, true);
+    if (ann.code.length > 0 && ann.code.str[0] == ' ')
+        ann.code = string_const(ann.code.str + 1, ann.code.length - 1);
+    if (ann.code.length > 0 && ann.code.str[ann.code.length - 1] == '\r')
+        ann.code.length--;
+
+    const size_t INFO_FIELD_COUNT = 3;
+    string_const_t infos[INFO_FIELD_COUNT] = { {0, 0}, {0, 0}, {0, 0} };
+    size_t info_count = string_split_fields(STRING_ARGS(infos_raw), ' ', infos, INFO_FIELD_COUNT, false);
+    FOUNDATION_ASSERT(info_count == INFO_FIELD_COUNT);
+
+    ann.author = infos[0];
+    ann.rev = infos[1];
+    ann.date = infos[2];
+    ann.time = string_to_date(STRING_ARGS(ann.date));
+
+    return ann;
+}
+
+struct annotations_chunk_t
+{
+    string_const_t text{};
+    lines_t lines{};
+    pool::line_id_t* records{};
+};
+
+static void split_annotations_chunks(size_t begin, size_t end, void* arg)
+{
+    annotations_chunk_t* chunks = (annotations_chunk_t*)arg;
+    for (size_t i = begin; i < end; ++i)
+        chunks[i].lines = string_split_lines(STRING_ARGS(chunks[i].text));
+}
+
+static void parse_annotations_chunks(size_t begin, size_t end, void* arg)
+{
+    annotations_chunk_t* chunks = (annotations_chunk_t*)arg;
+    for (size_t i = begin; i < end; ++i)
+    {
+        // Lines get parsed in batches, interned at once in the pool, which is shared with the other workers.
+        annotations_chunk_t& chunk = chunks[i];
+        pool::line_fields_t fields[ANNOTATIONS_BATCH_SIZE];
+        for (size_t l = 0; l < chunk.lines.count; l += ANNOTATIONS_BATCH_SIZE)
+        {
+            const size_t batch_count = generics::min(ANNOTATIONS_BATCH_SIZE, chunk.lines.count - l);
+            for (size_t b = 0; b < batch_count; ++b)
+                fields[b] = parse_annotation(chunk.lines.items[l + b]);
+            pool::intern_lines(fields, batch_count, chunk.records + l);
+        }
+        string_lines_finalize(chunk.lines);
+    }
+}
+
+timelapse::pool::line_id_t* timelapse::scm::annotation_lines(const char* str, size_t length)
+{
+    size_t chunk_count = generics::min(job_thread_count() + 1, length / ANNOTATIONS_CHUNK_MIN_SIZE);
+    chunk_count = generics::max((size_t)1, generics::min(chunk_count, MAX_ANNOTATIONS_CHUNKS));
+
+    // Cut the output in chunks of about the same size on line boundaries.
+    annotations_chunk_t chunks[MAX_ANNOTATIONS_CHUNKS];
+    for (size_t i = 0, offset = 0; i < chunk_count; ++i)
+    {
+        size_t end = length;
+        if (i + 1 < chunk_count)
+        {
+            end = string_find(str, length, STRING_NEWLINE[0], generics::max(offset, length * (i + 1) / chunk_count));
+            end = end == STRING_NPOS ? length : end + 1;
+        }
+
+        chunks[i].text = string_const(str + offset, end - offset);
+        offset = end;
+    }
+
+    // Find the lines of each chunk, then parse them straight into their slice of the records.
+    job_parallel_for(STRING_CONST("scm split annotations"), chunk_count, 1, split_annotations_chunks, chunks);
+
+    size_t line_count = 0;
+    for (size_t i = 0; i < chunk_count; ++i)
+        line_count += chunks[i].lines.count;
+
+    pool::line_id_t* records = nullptr;
+    if (line_count > 0)
+        array_resize(records, line_count);
+    for (size_t i = 0, first_line = 0; i < chunk_count; ++i)
+    {
+        chunks[i].records = records + first_line;
+        first_line += chunks[i].lines.count;
+    }
+
+    job_parallel_for(STRING_CONST("scm parse annotations"), chunk_count, 1, parse_annotations_chunks, chunks);
+
+    return records;
+}
+
+static scm::annotations_t parse_annotations(command_t* cmd)
+{
+    PROFILE_SCOPE("scm parse annotations");
+    scm::annotations_t ann;
+    scm::annotations_initialize(ann);
+
+    // Lines get parsed first, so the revision arena gets sized after its content rather than the default arena
+    // block, which would mostly be slack (i.e. a few KB of patch and line ids).
+    pool::line_id_t* lines = nullptr;
+    if (array_size(cmd->results) >= 1)
+        lines = scm::annotation_lines(STRING_ARGS(cmd->results[0]));
+
+    const size_t line_count = array_size(lines);
+    size_t arena_size = ANNOTATIONS_ARENA_SLACK + cmd->file.length + line_count * sizeof(pool::line_id_t);
+    for (size_t i = 1, end = generics::min((size_t)array_size(cmd->results), (size_t)4); i < end; ++i)
+        arena_size += cmd->results[i].length;
+
+    // Everything gets released at once with the revision arena, the lines themselves live in the pool.
+    ann.arena = memory_arena_allocate(HASH_SCM, arena_size);
+    scoped_arena_t scope(ann.arena);
+
+    ann.revid = cmd->context;
+    ann.file = string_clone(STRING_ARGS(cmd->file));
+
+    if (line_count > 0)
+    {
+        array_reserve(ann.lines, line_count);
+        array_resize(ann.lines, line_count);
+        memcpy(ann.lines, lines, line_count * sizeof(pool::line_id_t));
+    }
+    array_deallocate(lines);
+
+    if (array_size(cmd->results) >= 2)
+        ann.date = string_clone(STRING_ARGS(cmd->results[1]));
+
+    if (array_size(cmd->results) >= 3)
+        ann.base_summary = string_clone(STRING_ARGS(cmd->results[2]));
+
+    if (array_size(cmd->results) >= 4)
+        ann.patch = string_clone(STRING_ARGS(cmd->results[3]));
+
+    return ann;
+}
+
+static void* execute_annotations_request(void *arg)
+{
+    command_t* cmd = (command_t*)arg;
+    void* result = execute_annotations_commands(cmd);
+
+    // Parse what we got so the main thread only has to pick up the results.
+    cmd->annotations = parse_annotations(cmd);
+
+    return result;
+}
+
+static bool revision_date_compare(int a_id, const char* a_date, const char* a_merged_date, int b_id, const char* b_date, const char* b_merged_date)
 {
-    command_t* cmd = command_allocate(0, file_path, working_dir, execute_cmd_line_request);
+    if (a_merged_date[0] == '\0' && b_merged_date[0] != '\0')
+        return strcmp(a_date, b_merged_date) < 0;
+    if (a_merged_date[0] != '\0' && b_merged_date[0] == '\0')
+        return strcmp(a_merged_date, b_date) < 0;
+    if (a_merged_date[0] == '\0' && b_merged_date[0] == '\0')
+        return strcmp(a_date, b_date) < 0;
+    int compare_result = strcmp(a_merged_date, b_merged_date);
+    if (compare_result != 0)
+        return compare_result < 0;
+    return a_id < b_id;
+}
+
+static bool revision_order_key_compare(const revision_order_key_t& a, const revision_order_key_t& b)
+{
+    return revision_date_compare(a.id, a.date, a.merged_date, b.id, b.date, b.merged_date);
+}
+
+static void* execute_order_revisions_request(void* arg)
+{
+    PROFILE_SCOPE("scm order revisions");
+    command_t* cmd = (command_t*)arg;
+    std::sort(cmd->order_keys.begin(), cmd->order_keys.end(), revision_order_key_compare);
+
+    cmd->order.reserve(cmd->order_keys.size());
+    for (const auto& key : cmd->order_keys)
+        cmd->order.push_back(key.index);
+
+    cmd->exit_code = 0;
+    return 0;
+}
+
+timelapse::scm::request_t timelapse::scm::fetch_revisions(const char* file_path, const char* working_dir, bool wants_merges, int first_rev)
+{
+    command_t* cmd = command_allocate(0, file_path, working_dir, execute_revisions_request);
+
+    char range_buffer[32] = "";
+    if (first_rev > 0)
+        string_format(STRING_CONST(range_buffer), STRING_CONST(" and %d:"), first_rev);
 
     command_execute(cmd, STRING_CONST(
-        "hg log --template \"{rev}|{author|user}|{node|short}|{date|age}|{date|isodate}|{branch}|{desc|strip|firstline}\\n\" " \
-        " %s -r \"ancestors(branch(.))\" %s \"%s\""), 
+        "\"%s\" log --template \"{rev}|{author|user}|{node|short}|{date|age}|{date|isodate}|{branch}|{desc|strip|firstline}\\n\" " \
+        " %s -r \"ancestors(branch(.))%s\" %s \"%s\""), 
+        g_executable,
         #if BUILD_DEBUG
             "--date -360 ",
         #else
             "",
         #endif
+        range_buffer,
         wants_merges ? "" : "--no-merges", file_path);
 
     return (request_t)cmd;
@@ -233,6 +605,7 @@ bool timelapse::scm::revision_initialize(revision_t& r, string_const_t* infos, s
     }
 
     r.id = string_to_int(STRING_ARGS(infos[0]));
+    r.time = string_to_date(STRING_ARGS(infos[4]));
     r.author = string_clone_string(infos[1]);
     r.rev = string_clone_string(infos[2]);
     r.dateold = string_clone_string(infos[3]);
@@ -251,17 +624,199 @@ bool timelapse::scm::revision_initialize(revision_t& r, string_const_t* infos, s
 
 void timelapse::scm::revision_deallocate(revision_t& rev)
 {
-    string_deallocate(rev.rev.str);
-    string_deallocate(rev.author.str);
-    string_deallocate(rev.branch.str);
-    string_deallocate(rev.date.str);
-    string_deallocate(rev.dateold.str);
-    string_deallocate(rev.merged_date.str);
-    string_deallocate(rev.description.str);
-    string_deallocate(rev.patch.str);
-    string_deallocate(rev.base_summary.str);
+    // Info strings are released with the revision list arena, and annotation lines with the
+    // revision arena. Without one, the annotations only hold the pending fetch marker.
+    if (!rev.arena)
+        array_deallocate(rev.annotations);
+    memory_arena_deallocate(rev.arena);
+    memory_deallocate(rev.cold);
+
+    rev.annotations = nullptr;
+    rev.arena = nullptr;
+    rev.cold = nullptr;
+}
+
+/// Header of a compressed revision block, followed by the merged date (zero terminated) and the compressed
+/// patch, base summary and annotated lines. Lines are stored as text rather than pool ids, so the pool does not
+/// have to keep the lines only compressed revisions use, and they get interned again when decompressed.
+struct cold_revision_t
+{
+    uint32_t size;
+    uint32_t compressed_size;
+    uint32_t merged_date_length;
+};
+
+static uint8_t* write_cold_data(uint8_t* dst, const void* data, size_t size)
+{
+    memcpy(dst, data, size);
+    return dst + size;
+}
+
+static uint8_t* write_cold_string(uint8_t* dst, string_const_t str)
+{
+    const uint32_t length = (uint32_t)str.length;
+    dst = write_cold_data(dst, &length, sizeof(length));
+    return write_cold_data(dst, str.str, length);
+}
+
+static const uint8_t* read_cold_data(const uint8_t* src, void* data, size_t size)
+{
+    memcpy(data, src, size);
+    return src + size;
+}
+
+static const uint8_t* read_cold_string(const uint8_t* src, string_const_t& str)
+{
+    uint32_t length = 0;
+    src = read_cold_data(src, &length, sizeof(length));
+    str = string_const((const char*)src, length);
+    return src + length;
+}
+
+static size_t cold_line_size(const pool::line_t& line)
+{
+    const pool::string_id_t fields[] = { line.author, line.rev, line.date, line.code };
+    size_t size = sizeof(line.time);
+    for (const pool::string_id_t field : fields)
+        size += sizeof(uint32_t) + pool::string(field).length;
+    return size;
+}
+
+static uint8_t* write_cold_line(uint8_t* dst, const pool::line_t& line)
+{
+    dst = write_cold_data(dst, &line.time, sizeof(line.time));
+    dst = write_cold_string(dst, pool::string(line.author));
+    dst = write_cold_string(dst, pool::string(line.rev));
+    dst = write_cold_string(dst, pool::string(line.date));
+    return write_cold_string(dst, pool::string(line.code));
+}
+
+/// The fields reference the decompressed data, until they get interned.
+static const uint8_t* read_cold_line(const uint8_t* src, pool::line_fields_t& fields)
+{
+    src = read_cold_data(src, &fields.time, sizeof(fields.time));
+    src = read_cold_string(src, fields.author);
+    src = read_cold_string(src, fields.rev);
+    src = read_cold_string(src, fields.date);
+    return read_cold_string(src, fields.code);
+}
 
-    string_array_deallocate(rev.annotations);
+bool timelapse::scm::revision_compress(revision_t& rev)
+{
+    if (!rev.arena || rev.cold || !rev.extra_fetched)
+        return false;
+
+    PROFILE_SCOPE("revision compress");
+    const uint32_t line_count = array_size(rev.annotations);
+    size_t size = sizeof(uint32_t) * 3 + rev.patch.length + rev.base_summary.length;
+    for (uint32_t i = 0; i < line_count; ++i)
+        size += cold_line_size(pool::line(rev.annotations[i]));
+    const size_t capacity = lz_compress_bound(size);
+    uint8_t* buffer = (uint8_t*)memory_allocate(HASH_SCM, size + capacity, 0, MEMORY_TEMPORARY | MEMORY_NO_ARENA);
+
+    uint8_t* data = write_cold_string(buffer, string_to_const(rev.patch));
+    data = write_cold_string(data, string_to_const(rev.base_summary));
+    data = write_cold_data(data, &line_count, sizeof(line_count));
+    for (uint32_t i = 0; i < line_count; ++i)
+        data = write_cold_line(data, pool::line(rev.annotations[i]));
+
+    // Measured against the data itself (its pooled lines included) rather than the arena, which has some slack.
+    uint8_t* compressed = buffer + size;
+    const size_t compressed_size = lz_compress(buffer, size, compressed, capacity);
+    const size_t cold_size = sizeof(cold_revision_t) + rev.merged_date.length + 1 + compressed_size;
+    if (compressed_size == 0 || cold_size >= size)
+    {
+        memory_deallocate(buffer);
+        return false;
+    }
+
+    cold_revision_t header;
+    header.size = (uint32_t)size;
+    header.compressed_size = (uint32_t)compressed_size;
+    header.merged_date_length = (uint32_t)rev.merged_date.length;
+
+    uint8_t* cold = (uint8_t*)memory_allocate(HASH_SCM, cold_size, 0, MEMORY_PERSISTENT | MEMORY_NO_ARENA);
+    data = write_cold_data(cold, &header, sizeof(header));
+    char* merged_date = (char*)data;
+    data = write_cold_data(data, rev.merged_date.str, rev.merged_date.length);
+    *data++ = '\0';
+    write_cold_data(data, compressed, compressed_size);
+    memory_deallocate(buffer);
+
+    memory_arena_deallocate(rev.arena);
+    rev.arena = nullptr;
+    rev.cold = cold;
+    rev.merged_date = { merged_date, header.merged_date_length };
+    rev.patch = {};
+    rev.base_summary = {};
+    rev.annotations = nullptr;
+    return true;
+}
+
+size_t timelapse::scm::revision_compressed_size(const revision_t& rev)
+{
+    if (!rev.cold)
+        return 0;
+
+    const cold_revision_t* header = (const cold_revision_t*)rev.cold;
+    return sizeof(cold_revision_t) + header->merged_date_length + 1 + header->compressed_size;
+}
+
+void timelapse::scm::revision_decompress(revision_t& rev)
+{
+    if (!rev.cold)
+        return;
+
+    PROFILE_SCOPE("revision decompress");
+    cold_revision_t header;
+    const char* merged_date = (const char*)read_cold_data((const uint8_t*)rev.cold, &header, sizeof(header));
+    const uint8_t* compressed = (const uint8_t*)merged_date + header.merged_date_length + 1;
+
+    uint8_t* buffer = (uint8_t*)memory_allocate(HASH_SCM, header.size, 0, MEMORY_TEMPORARY | MEMORY_NO_ARENA);
+    if (lz_decompress(compressed, header.compressed_size, buffer, header.size) != header.size)
+    {
+        log_errorf(HASH_SCM, ERROR_INVALID_VALUE, STRING_CONST("Failed to decompress revision %d, fetching it again"), rev.id);
+        memory_deallocate(buffer);
+        revision_deallocate(rev);
+        rev.extra_fetched = false;
+        rev.merged_date = {};
+        return;
+    }
+
+    string_const_t patch, base_summary;
+    uint32_t line_count = 0;
+    const uint8_t* data = read_cold_string(buffer, patch);
+    data = read_cold_string(data, base_summary);
+    data = read_cold_data(data, &line_count, sizeof(line_count));
+
+    pool::line_fields_t* lines = (pool::line_fields_t*)memory_allocate(HASH_SCM, (line_count + 1) * sizeof(pool::line_fields_t), 0, MEMORY_TEMPORARY | MEMORY_NO_ARENA);
+    for (uint32_t i = 0; i < line_count; ++i)
+        data = read_cold_line(data, lines[i]);
+
+    rev.arena = memory_arena_allocate(HASH_SCM, header.merged_date_length + patch.length + base_summary.length + (line_count + 1) * sizeof(pool::line_id_t) + 256);
+    {
+        scoped_arena_t scope(rev.arena);
+        rev.merged_date = string_clone(merged_date, header.merged_date_length);
+        rev.patch = string_clone(STRING_ARGS(patch));
+        rev.base_summary = string_clone(STRING_ARGS(base_summary));
+
+        // Reserved even without any line, since revisions without any capacity get annotations fetched.
+        array_reserve(rev.annotations, line_count + 1);
+        array_resize(rev.annotations, line_count);
+        pool::intern_lines(lines, line_count, rev.annotations);
+    }
+
+    memory_deallocate(lines);
+    memory_deallocate(buffer);
+    memory_deallocate(rev.cold);
+    rev.cold = nullptr;
+}
+
+bool timelapse::scm::revision_compare(const revision_t& a, const revision_t& b)
+{
+    return revision_date_compare(
+        a.id, a.date.str ? a.date.str : "", a.merged_date.str ? a.merged_date.str : "", 
+        b.id, b.date.str ? b.date.str : "", b.merged_date.str ? b.merged_date.str : "");
 }
 
 void timelapse::scm::annotations_initialize(annotations_t& ann)
@@ -272,16 +827,36 @@ void timelapse::scm::annotations_initialize(annotations_t& ann)
     ann.patch = { 0, 0 };
     ann.base_summary = { 0, 0};
     ann.lines = nullptr;
+    ann.arena = nullptr;
 }
 
 void timelapse::scm::annotations_finailze(annotations_t& ann)
 {
-    string_deallocate(ann.file.str);
-    string_deallocate(ann.date.str);
-    string_deallocate(ann.patch.str);
-    string_deallocate(ann.base_summary.str);
+    memory_arena_deallocate(ann.arena);
+    annotations_initialize(ann);
+}
 
-    string_array_deallocate(ann.lines);
+void timelapse::scm::revision_set_annotations(revision_t& rev, annotations_t& ann)
+{
+    // Swapped first, the previous data is released from ann once the revision no longer refers to any of it.
+    std::swap(rev.patch, ann.patch);
+    std::swap(rev.base_summary, ann.base_summary);
+    std::swap(rev.merged_date, ann.date);
+    std::swap(rev.annotations, ann.lines);
+    std::swap(rev.arena, ann.arena);
+
+    // Without an arena, the previous annotations only hold the pending fetch marker.
+    if (!ann.arena)
+        array_deallocate(ann.lines);
+    memory_deallocate(rev.cold);
+    rev.cold = nullptr;
+
+    annotations_finailze(ann);
+}
+
+void timelapse::scm::set_request_completed_handler(request_completed_handler_t handler)
+{
+    g_request_completed_handler = handler;
 }
 
 bool timelapse::scm::is_request_done(request_t request)
@@ -290,23 +865,72 @@ bool timelapse::scm::is_request_done(request_t request)
         return true;
 
     command_t* cmd = (command_t*)request;
-    return !thread_is_running(cmd->thread);
+    return atomic_load32(&cmd->completed, memory_order_acquire) != 0 || !thread_is_running(cmd->thread);
 }
 
 size_t timelapse::scm::dispose_request(request_t request)
 {
     command_t* cmd = (command_t*)request;
 
-    if (thread_is_running(cmd->thread))
+    // The thread state only changes once the thread actually runs, so a command started
+    // right before being disposed would not be seen as running yet.
+    if (cmd->started)
     {
         thread_signal(cmd->thread);
         thread_join(cmd->thread);
     }
 
+    // The command is still linked in the completed queue, it will get released once popped.
+    if (cmd->started && !cmd->popped)
+    {
+        cmd->disposed = true;
+        return 0;
+    }
+
     command_deallocate(cmd);
     return 0;
 }
 
+timelapse::scm::request_t timelapse::scm::pop_completed_request()
+{
+    while (command_t* cmd = g_completed_commands.pop())
+    {
+        atomic_decr32(&g_queued_requests, memory_order_relaxed);
+        cmd->popped = true;
+        if (!cmd->disposed)
+            return (request_t)cmd;
+
+        command_deallocate(cmd);
+    }
+
+    return 0;
+}
+
+bool timelapse::scm::has_completed_requests()
+{
+    return !g_completed_commands.empty();
+}
+
+timelapse::scm::stats_t timelapse::scm::stats()
+{
+    stats_t stats;
+    stats.running_requests = atomic_load32(&g_running_requests, memory_order_relaxed);
+    stats.queued_requests = atomic_load32(&g_queued_requests, memory_order_relaxed);
+    stats.running_processes = atomic_load32(&g_running_processes, memory_order_relaxed);
+    stats.spawned_processes = atomic_load32(&g_spawned_processes, memory_order_relaxed);
+    return stats;
+}
+
+void timelapse::scm::set_executable(const char* path, size_t length)
+{
+    string_copy(STRING_CONST(g_executable), path, length);
+}
+
+void timelapse::scm::set_low_priority(bool enabled)
+{
+    g_low_priority = enabled;
+}
+
 const string_t* timelapse::scm::request_results(request_t request)
 {
     if (!is_request_done(request))
@@ -316,14 +940,14 @@ const string_t* timelapse::scm::request_results(request_t request)
     return cmd->results;
 }
 
-generics::vector<timelapse::scm::revision_t> timelapse::scm::revision_list(const string_t* changes, size_t change_count)
+generics::vector<timelapse::scm::revision_t> timelapse::scm::revision_list(const string_const_t* changes, size_t change_count)
 {
     generics::vector<revision_t> revisions;
 
     for (size_t i = 0; i < change_count; ++i)
     {
         string_const_t infos[16];
-        size_t info_count = string_explode(STRING_ARGS(changes[i]), STRING_CONST("|"), infos, SCM_ARRAYSIZE(infos), false);
+        size_t info_count = string_split_fields(STRING_ARGS(changes[i]), '|', infos, SCM_ARRAYSIZE(infos), false);
 
         revision_t r;
         if (revision_initialize(r, infos, info_count))
@@ -333,13 +957,30 @@ generics::vector<timelapse::scm::revision_t> timelapse::scm::revision_list(const
     return revisions;
 }
 
-timelapse::scm::request_t timelapse::scm::fetch_revision_annotations(const char* file_path, const char* working_dir, int revid)
+timelapse::scm::request_t timelapse::scm::fetch_revision_annotations(const char* file_path, const char* working_dir, int revid, const char* node)
 {
     command_t* cmd = command_allocate(revid, file_path, working_dir, execute_annotations_request);
+    cmd->node = string_clone(node, strlen(node));
     command_execute(cmd, nullptr, 0);
     return (request_t)cmd;
 }
 
+timelapse::scm::request_t timelapse::scm::fetch_parent_revision(const char* file_path, const char* working_dir)
+{
+    command_t* cmd = command_allocate(-1, file_path, working_dir, execute_parent_revision_request);
+    command_execute(cmd, STRING_CONST("\"%s\" parents --template \"{rev}\\n\" \"%s\""), g_executable, file_path);
+    return (request_t)cmd;
+}
+
+int timelapse::scm::parent_revision(request_t request)
+{
+    if (!is_request_done(request))
+        return -1;
+
+    const auto cmd = (command_t*)request;
+    return cmd->context;
+}
+
 timelapse::scm::annotations_t timelapse::scm::revision_annotations(request_t request)
 {
     annotations_t ann;
@@ -349,27 +990,49 @@ timelapse::scm::annotations_t timelapse::scm::revision_annotations(request_t req
         return ann;
 
     auto* cmd = (command_t*)request;
+    std::swap(ann, cmd->annotations);
+    return ann;
+}
 
-    ann.revid = cmd->context;
+generics::vector<timelapse::scm::revision_t> timelapse::scm::request_revisions(request_t request, memory_arena_t*& arena)
+{
+    generics::vector<revision_t> revisions;
+    arena = nullptr;
+    if (!is_request_done(request))
+        return revisions;
 
-    ann.file = string_clone(STRING_ARGS(cmd->file));
+    auto* cmd = (command_t*)request;
+    revisions.swap(cmd->revisions);
+    std::swap(arena, cmd->arena);
+    return revisions;
+}
 
-    if (array_size(cmd->results) >= 1)
+timelapse::scm::request_t timelapse::scm::order_revisions(const revision_t* revisions, size_t revision_count)
+{
+    command_t* cmd = command_allocate(0, "", "", execute_order_revisions_request);
+
+    // Copy the sort keys, so the revisions can keep being updated while the worker sorts them.
+    cmd->order_keys.resize(revision_count);
+    for (size_t i = 0; i < revision_count; ++i)
     {
-        lines_t lines = string_split_lines(STRING_ARGS(cmd->results[0]));
-        for (size_t i = 0; i < lines.count; ++i)
-            array_push(ann.lines, string_clone(STRING_ARGS(lines[i])));
-        string_lines_finalize(lines);
+        revision_order_key_t& key = cmd->order_keys[i];
+        key.index = (unsigned)i;
+        key.id = revisions[i].id;
+        string_copy(key.date, sizeof(key.date), STRING_ARGS(revisions[i].date));
+        string_copy(key.merged_date, sizeof(key.merged_date), STRING_ARGS(revisions[i].merged_date));
     }
 
-    if (array_size(cmd->results) >= 2)
-        ann.date = string_clone(STRING_ARGS(cmd->results[1]));
+    command_execute(cmd, nullptr, 0);
+    return (request_t)cmd;
+}
 
-    if (array_size(cmd->results) >= 3)
-        ann.base_summary = string_clone(STRING_ARGS(cmd->results[2]));
+generics::vector<unsigned> timelapse::scm::revision_order(request_t request)
+{
+    generics::vector<unsigned> order;
+    if (!is_request_done(request))
+        return order;
 
-    if (array_size(cmd->results) >= 4)
-        ann.patch = string_clone(STRING_ARGS(cmd->results[3]));
-    
-    return ann;
+    auto* cmd = (command_t*)request;
+    order.swap(cmd->order);
+    return order;
 }
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "common.h"
+#include "pool.h"
 
 namespace timelapse { namespace scm {
     
     typedef size_t request_t;
+    typedef void (*request_completed_handler_t)();
 
+    /// The info strings of a revision are allocated from the arena of the revision list, while
+    /// the extra data fetched later on (patch, summary, annotations) lives in the revision arena.
     struct revision_t
     {
         int id{};
@@ -16,33 +20,68 @@ namespace timelapse { namespace scm {
         string_t date{};
         string_t dateold{};
         string_t description{};
+        time_t time{};
 
         bool extra_fetched{};
         string_t merged_date{};
         string_t patch{};
         string_t base_summary{};
 
-        string_t* annotations{};
+        /// Ids of the annotated lines in the line pool (see pool.h).
+        pool::line_id_t* annotations{};
+        memory_arena_t* arena{};
+
+        /// Extra data of a revision not viewed for a while, compressed in place of its arena (see revision_compress).
+        void* cold{};
+        /// Session access stamp, the revisions accessed the least recently get compressed first.
+        size_t access{};
     };
 
     bool revision_initialize(revision_t& r, string_const_t* infos, size_t info_count);
     void revision_deallocate(revision_t& rev);
 
+    /// Compresses the extra data of a fetched revision (see foundation/lz.h) and releases its arena. The merged
+    /// date is kept aside uncompressed, since revisions get ordered by it. Annotated lines get compressed as text, so
+    /// they no longer need to stay in the pool. Returns false if the revision has no extra data or would not get any
+    /// smaller.
+    bool revision_compress(revision_t& rev);
+
+    /// Restores the extra data of a compressed revision in a new arena, interning its lines again, or marks it to be
+    /// fetched again if the compressed data got corrupted. Does nothing if the revision is not compressed.
+    void revision_decompress(revision_t& rev);
+
+    /// Returns the memory used by a compressed revision, 0 if not compressed.
+    size_t revision_compressed_size(const revision_t& rev);
+
+    /// Orders revisions by their merged date (or commit date if not merged yet).
+    bool revision_compare(const revision_t& a, const revision_t& b);
+
     struct annotations_t
     {
         int revid{};
         string_t file{};
         string_t date{};
         string_t base_summary{};
-        string_t* lines{};
+        pool::line_id_t* lines{};
         string_t patch{};
+
+        /// Holds everything above.
+        memory_arena_t* arena{};
     };
 
     void annotations_initialize(annotations_t& ann);
     void annotations_finailze(annotations_t& ann);
 
-    /// Fetch scm revision for a given file in another thread.
-    request_t fetch_revisions(const char* file_path, const char* working_dir, bool wants_merges);
+    /// Hands the fetched annotations over to the revision, then releases the revision's previous extra data (along
+    /// with its arena or compressed block). Leaves ann empty.
+    void revision_set_annotations(revision_t& rev, annotations_t& ann);
+
+    /// Fetch scm revision for a given file in another thread. Only the revisions from the given local
+    /// revision number on are fetched, if any (i.e. the ones committed since the last fetch).
+    request_t fetch_revisions(const char* file_path, const char* working_dir, bool wants_merges, int first_rev = 0);
+
+    /// Sets a handler invoked from the worker thread each time a scm request completes.
+    void set_request_completed_handler(request_completed_handler_t handler);
 
     /// Check if the scm command has finished.
     bool is_request_done(request_t request);
@@ -50,16 +89,62 @@ namespace timelapse { namespace scm {
     /// Release any resources used by the fetch command.
     size_t dispose_request(request_t request);
 
+    /// Returns the next request completed by a worker thread (in completion order), or 0 if there is none.
+    /// Must be called from the main thread.
+    request_t pop_completed_request();
+
+    /// Are there any completed requests waiting to be popped?
+    bool has_completed_requests();
+
+    /// Snapshot of the request counters, used by the diagnostics overlay.
+    struct stats_t
+    {
+        int running_requests{};
+        int queued_requests{};
+        int running_processes{};
+        int spawned_processes{};
+    };
+
+    stats_t stats();
+
+    /// Sets the scm executable invoked by the requests (hg by default, i.e. looked up in the PATH).
+    void set_executable(const char* path, size_t length);
+
+    /// Runs the next requests and their processes at low priority, so they only use idle cpu time.
+    void set_low_priority(bool enabled);
+
     /// Returns the request result if done.
     const string_t* request_results(request_t request);
 
     /// Parse the fetch revisions output and return the revision list container.
-    generics::vector<revision_t> revision_list(const string_t* changes, size_t change_count);
+    /// The revision info strings are allocated from the active memory arena.
+    generics::vector<revision_t> revision_list(const string_const_t* changes, size_t change_count);
+
+    /// Returns the revision list parsed by the fetch revisions request worker, along with the arena
+    /// holding their info strings, which is to be released once the revisions are deallocated.
+    generics::vector<revision_t> request_revisions(request_t request, memory_arena_t*& arena);
 
-    /// Fetch additional info for a single revision
-    request_t fetch_revision_annotations(const char* file_path, const char* working_dir, int revid);
+    /// Fetch additional info for a single revision, given by both its id and its changeset hash (see revision_t::rev).
+    /// The commands refer to the revision by its hash, so that their cached outputs stay valid when ids change.
+    request_t fetch_revision_annotations(const char* file_path, const char* working_dir, int revid, const char* node);
 
-    /// Parse the annotations command result and return an object with the data.
+    /// Fetch the revision in which the file was last changed, as of the working copy parent.
+    request_t fetch_parent_revision(const char* file_path, const char* working_dir);
+
+    /// Returns the local revision number fetched by fetch_parent_revision, or -1 if none (i.e. file not committed yet).
+    int parent_revision(request_t request);
+
+    /// Returns the annotations data parsed by the request worker.
     annotations_t revision_annotations(request_t request);
 
+    /// Parse annotate output lines (in parallel on the job workers for large outputs). The lines get interned in the
+    /// line pool, so the output can be released right away, and the line id array is allocated from the active memory arena.
+    pool::line_id_t* annotation_lines(const char* str, size_t length);
+
+    /// Sort a snapshot of the revisions in another thread.
+    request_t order_revisions(const revision_t* revisions, size_t revision_count);
+
+    /// Returns the revision indexes (in the snapshot given to order_revisions) in sorted order.
+    generics::vector<unsigned> revision_order(request_t request);
+
 }}
@@ -1,14 +1,27 @@
 #include "session.h"
 #include "scm_proxy.h"
+#include "wdir.h"
+#include "replay.h"
 #include "common.h"
+#include "timing.h"
 
 #include "foundation/environment.h"
 #include "foundation/path.h"
 #include "foundation/string.h"
 #include "foundation/foundation.h"
+#include "foundation/time.h"
+#include "foundation/fs.h"
+#include "foundation/event.h"
+#include "foundation/stream.h"
+#include "foundation/system.h"
+#include "foundation/array.h"
+#include "foundation/hashstrings.h"
+#include "foundation/memory.h"
 
 #include <algorithm>
 
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
 namespace timelapse { namespace session {
 
 // File being timelapsed
@@ -19,15 +32,142 @@ string_t g_working_dir{};
 const size_t MAX_SINGLE_FETCH = 3;
 scm::request_t g_request_fetch_revisions = 0;
 scm::request_t g_request_fetch_single_revisions[MAX_SINGLE_FETCH] = { 0 };
+scm::request_t g_request_order_revisions = 0;
+scm::request_t g_request_refresh_revisions = 0;
+scm::request_t g_request_parent_revision = 0;
+
+// Time budget given to process completed requests in a single update, the rest is processed next frames.
+const double COMPLETED_REQUESTS_TIME_BUDGET = 0.004;
 
-// Fetch revision data
+// Fetch revision data, the info strings of the revisions fetched by each refresh live in their own arena.
 int g_current_revision_id = -1;
 generics::vector<scm::revision_t> g_revisions;
+generics::vector<memory_arena_t*> g_revisions_arenas;
+// Cleared for loaded revisions which have no repository to fetch their annotations from (i.e. benchmarks).
+bool g_fetch_annotations = true;
+
+// Repository (i.e. its .hg directory) being monitored, any change to its changelog fetches the new revisions once it
+// settles, any change to its dirstate (i.e. update) fetches the parent of the working copy again.
+// The path is kept the way fs_monitor stores it (absolute and cleaned up), which fs_unmonitor matches against.
+const double REFRESH_DELAY = 0.5;
+string_t g_repository_path{};
+bool g_refresh_requested = false;
+tick_t g_refresh_request_time = 0;
+bool g_parent_refresh_requested = false;
+tick_t g_parent_refresh_request_time = 0;
+
+// Working copy pseudo revision, kept at the head of the revisions while the file has uncommitted changes. It gets
+// annotated again from the parent revision annotations each time the file gets saved, once it settles.
+const double WORKING_COPY_REFRESH_DELAY = 0.2;
+string_t g_file_absolute_path{};
+// Kept the way fs_monitor stores it, like the repository path.
+string_t g_working_dir_monitored{};
+int g_parent_revision_id = -1;
+const pool::line_id_t* g_working_copy_parent_annotations = nullptr;
+bool g_working_copy_dirty = false;
+tick_t g_working_copy_change_time = 0;
+
+// Revision ordering, computed in a worker thread from a snapshot of the revisions.
+// The generation changes each time g_revisions gets replaced or reordered, which invalidates any pending order.
+size_t g_revisions_generation = 0;
+size_t g_order_revisions_generation = 0;
+bool g_revisions_order_dirty = false;
+
+// Memory the extra data of the revisions (i.e. their arena and pooled lines) may use before the revisions viewed the
+// least recently get compressed, within a time budget per update. They get decompressed when viewed again, the ones
+// around the cursor ahead of time since they are likely to be viewed next. Revisions get compressed down to 3/4 of
+// the working set, so the pool gets flushed once per quarter of the working set fetched rather than for each revision.
+const size_t DEFAULT_WORKING_SET = 64 * 1024 * 1024;
+const int WORKING_SET_PREFETCH_DISTANCE = 2;
+const double WORKING_SET_TIME_BUDGET = 0.002;
+size_t g_working_set = DEFAULT_WORKING_SET;
+size_t g_access_clock = 0;
+bool g_working_set_dirty = false;
+
+// Set once revisions got compressed, the pool then only keeps the lines of the resident revisions (see flush_pool).
+bool g_pool_flush_requested = false;
+
+static void unwatch_repository()
+{
+    if (g_repository_path.length > 0)
+        fs_unmonitor(STRING_ARGS(g_repository_path));
+    string_deallocate(g_repository_path.str);
+    g_repository_path = {};
+    g_refresh_requested = false;
+    g_parent_refresh_requested = false;
+}
+
+/// Monitors the repository holding the working directory, if any.
+static void watch_repository()
+{
+    unwatch_repository();
+
+    // Walking up a relative working directory would stop at the current directory.
+    char dir_buffer[BUILD_MAX_PATHLEN];
+    string_t working_dir = string_copy(STRING_CONST(dir_buffer), STRING_ARGS(g_working_dir));
+    working_dir = path_absolute(STRING_ARGS(working_dir), sizeof(dir_buffer));
+
+    char path_buffer[BUILD_MAX_PATHLEN];
+    string_const_t dir = string_to_const(working_dir);
+    while (dir.length > 0)
+    {
+        string_t repository_path = path_concat(STRING_CONST(path_buffer), STRING_ARGS(dir), STRING_CONST(".hg"));
+        if (fs_is_directory(STRING_ARGS(repository_path)))
+        {
+            repository_path = path_clean(STRING_ARGS(repository_path), sizeof(path_buffer));
+            g_repository_path = path_allocate_absolute(STRING_ARGS(repository_path));
+            if (!fs_monitor(STRING_ARGS(g_repository_path)))
+            {
+                string_deallocate(g_repository_path.str);
+                g_repository_path = {};
+            }
+            return;
+        }
+
+        const string_const_t parent_dir = path_directory_name(STRING_ARGS(dir));
+        if (parent_dir.length >= dir.length)
+            break;
+        dir = parent_dir;
+    }
+}
+
+static void unwatch_working_copy()
+{
+    if (g_working_dir_monitored.length > 0)
+        fs_unmonitor(STRING_ARGS(g_working_dir_monitored));
+    string_deallocate(g_working_dir_monitored.str);
+    string_deallocate(g_file_absolute_path.str);
+    g_working_dir_monitored = {};
+    g_file_absolute_path = {};
+    g_working_copy_dirty = false;
+}
+
+/// Monitors the directory of the file, so saving it annotates the working copy again.
+static void watch_working_copy()
+{
+    unwatch_working_copy();
+
+    // Event paths are absolute and cleaned up.
+    g_file_absolute_path = path_allocate_absolute(STRING_ARGS(g_file_path));
+    char path_buffer[BUILD_MAX_PATHLEN];
+    string_t working_dir = string_copy(STRING_CONST(path_buffer), STRING_ARGS(g_working_dir));
+    working_dir = path_clean(STRING_ARGS(working_dir), sizeof(path_buffer));
+    g_working_dir_monitored = path_allocate_absolute(STRING_ARGS(working_dir));
+    if (!fs_monitor(STRING_ARGS(g_working_dir_monitored)))
+    {
+        string_deallocate(g_working_dir_monitored.str);
+        g_working_dir_monitored = {};
+    }
+}
 
 static void cleanup()
 {
+    unwatch_repository();
+    unwatch_working_copy();
     string_deallocate(g_file_path.str);
     string_deallocate(g_working_dir.str);
+    g_file_path = {};
+    g_working_dir = {};
 }
 
 static void cancel_pending_requests()
@@ -40,6 +180,20 @@ static void cancel_pending_requests()
         if (g_request_fetch_single_revisions[i] != 0)
             g_request_fetch_single_revisions[i] = scm::dispose_request(g_request_fetch_single_revisions[i]);
     }
+
+    if (g_request_order_revisions != 0)
+        g_request_order_revisions = scm::dispose_request(g_request_order_revisions);
+    g_revisions_order_dirty = false;
+
+    if (g_request_refresh_revisions != 0)
+        g_request_refresh_revisions = scm::dispose_request(g_request_refresh_revisions);
+
+    if (g_request_parent_revision != 0)
+        g_request_parent_revision = scm::dispose_request(g_request_parent_revision);
+
+    // Release any other completed request not processed yet.
+    while (scm::request_t request = scm::pop_completed_request())
+        scm::dispose_request(request);
 }
 
 static void clear_revisions_info()
@@ -47,21 +201,14 @@ static void clear_revisions_info()
     for (auto& rev: g_revisions)
         scm::revision_deallocate(rev);
     g_revisions.clear();
+    for (auto& arena : g_revisions_arenas)
+        memory_arena_deallocate(arena);
+    g_revisions_arenas.clear();
+    g_revisions_generation++;
     g_current_revision_id = -1;
-}
-
-static bool revision_compare(const scm::revision_t& a, const scm::revision_t& b)
-{
-    if (a.merged_date.length == 0 && b.merged_date.length != 0)
-        return strcmp(a.date.str, b.merged_date.str) < 0;
-    if (a.merged_date.length != 0 && b.merged_date.length == 0)
-        return strcmp(a.merged_date.str, b.date.str) < 0;
-    if (a.merged_date.length == 0 && b.merged_date.length == 0)
-        return strcmp(a.date.str, b.date.str) < 0;
-    int compare_result = strcmp(a.merged_date.str, b.merged_date.str);
-    if (compare_result != 0)
-        return compare_result < 0;
-    return a.id < b.id;
+    g_working_copy_parent_annotations = nullptr;
+    g_working_set_dirty = false;
+    g_pool_flush_requested = false;
 }
 
 void setup(const char* file_path)
@@ -82,8 +229,18 @@ void setup(const char* file_path)
 
     if (is_valid())
     {
+        // Nothing references the pooled lines of the previous file anymore.
         cancel_pending_requests();
         clear_revisions_info();
+        pool::reset();
+        g_parent_revision_id = -1;
+
+        // Replayed sessions only change through their trace, whatever happens to the files on this machine.
+        if (!replay::is_replaying())
+        {
+            watch_repository();
+            watch_working_copy();
+        }
     }
 }
 
@@ -91,15 +248,33 @@ void shutdown()
 {
     cancel_pending_requests();
     clear_revisions_info();
+    pool::reset();
     cleanup();
 }
 
+/// The working copy parent only changes along with the changelog (i.e. commit), or when updating to another revision.
+static void fetch_parent_revision()
+{
+    if (g_request_parent_revision == 0)
+        g_request_parent_revision = scm::fetch_parent_revision(file_path(), working_dir());
+}
+
 bool fetch_revisions()
 {
     g_request_fetch_revisions = scm::fetch_revisions(file_path(), working_dir(), false);
+    fetch_parent_revision();
     return g_request_fetch_revisions != 0;
 }
 
+void load_revisions(generics::vector<scm::revision_t>& revisions, memory_arena_t* arena, bool fetch_annotations)
+{
+    clear_revisions_info();
+    g_revisions.swap(revisions);
+    if (arena)
+        g_revisions_arenas.push_back(arena);
+    g_fetch_annotations = fetch_annotations;
+}
+
 bool has_revisions()
 {
     return g_revisions.size() > 0;
@@ -107,86 +282,536 @@ bool has_revisions()
 
 bool is_fetching_revisions()
 {
-    return !scm::is_request_done(g_request_fetch_revisions);
+    return g_request_fetch_revisions != 0;
 }
 
-void update()
+static bool has_working_copy_revision()
 {
-    // TODO: throttle update
+    return !g_revisions.empty() && g_revisions.back().id == wdir::REVISION_ID;
+}
 
-    if (g_request_fetch_revisions != 0)
+/// Number of revisions before the working copy one, if any, which are the only ones getting ordered.
+static size_t committed_revision_count()
+{
+    return g_revisions.size() - (has_working_copy_revision() ? 1 : 0);
+}
+
+static void process_revisions_request(scm::request_t request)
+{
+    PROFILE_SCOPE("session revisions");
+    // The revision list comes already sorted from the worker.
+    memory_arena_t* arena = nullptr;
+    generics::vector<scm::revision_t> revisions = scm::request_revisions(request, arena);
+    load_revisions(revisions, arena);
+}
+
+/// Appends the revisions committed since the last fetch, which then get ordered along the others in
+/// a worker thread. Their annotations get fetched like for any other revision without any.
+static void process_refresh_revisions_request(scm::request_t request)
+{
+    PROFILE_SCOPE("session refresh revisions");
+    memory_arena_t* arena = nullptr;
+    generics::vector<scm::revision_t> revisions = scm::request_revisions(request, arena);
+
+    // New revisions go before the working copy one.
+    scm::revision_t working_copy_rev;
+    const bool has_working_copy = has_working_copy_revision();
+    if (has_working_copy)
     {
-        // Check fetched revisions
-        if (scm::is_request_done(g_request_fetch_revisions))
-        {
-            const string_t* results = scm::request_results(g_request_fetch_revisions);
-            g_revisions = scm::revision_list(results, array_size(results));
-            g_request_fetch_revisions = scm::dispose_request(g_request_fetch_revisions);
+        working_copy_rev = g_revisions.back();
+        g_revisions.pop_back();
+    }
 
-            std::sort(g_revisions.begin(), g_revisions.end(), revision_compare);
+    size_t added_count = 0;
+    for (const auto& rev : revisions)
+    {
+        if (find_revision(rev.id))
+            continue;
+        g_revisions.push_back(rev);
+        added_count++;
+    }
 
-            if (g_revisions.size() > 0)
-                set_current_revision(g_revisions.back().id);
+    if (has_working_copy)
+        g_revisions.push_back(working_copy_rev);
+
+    // The arena only holds the info strings of the fetched revisions, it goes away if none got added.
+    if (added_count == 0)
+    {
+        memory_arena_deallocate(arena);
+    }
+    else
+    {
+        if (arena)
+            g_revisions_arenas.push_back(arena);
+        g_revisions_generation++;
+        g_revisions_order_dirty = true;
+        fetch_parent_revision();
+    }
+}
+
+static void process_order_revisions_request(scm::request_t request)
+{
+    PROFILE_SCOPE("session order revisions");
+    generics::vector<unsigned> order = scm::revision_order(request);
+
+    // Drop orders computed on an older revision set, a new one is already requested if needed.
+    if (g_order_revisions_generation != g_revisions_generation || order.size() != committed_revision_count())
+        return;
+
+    generics::vector<scm::revision_t> ordered_revisions;
+    ordered_revisions.reserve(g_revisions.size());
+    for (const auto& index : order)
+        ordered_revisions.push_back(g_revisions[index]);
+    if (has_working_copy_revision())
+        ordered_revisions.push_back(g_revisions.back());
+
+    g_revisions.clear();
+    g_revisions.swap(ordered_revisions);
+    g_revisions_generation++;
+}
+
+static void order_revisions()
+{
+    if (!g_revisions_order_dirty || g_request_order_revisions != 0)
+        return;
+
+    g_order_revisions_generation = g_revisions_generation;
+    g_request_order_revisions = scm::order_revisions(g_revisions.begin(), committed_revision_count());
+    g_revisions_order_dirty = false;
+}
+
+static void process_file_events()
+{
+    event_block_t* block = event_stream_process(fs_event_stream());
+    event_t* event = nullptr;
+    while ((event = event_next(block, event)))
+    {
+        // Commits (i.e. pull, commit) always end up appending to the changelog.
+        const string_const_t path = fs_event_path(event);
+        if (g_repository_path.length > 0 && string_find_string(STRING_ARGS(path), STRING_CONST("00changelog"), 0) != STRING_NPOS)
+        {
+            g_refresh_requested = true;
+            g_refresh_request_time = time_current();
+        }
+        // Updating to another revision always rewrites the dirstate.
+        else if (g_repository_path.length > 0 && string_ends_with(STRING_ARGS(path), STRING_CONST("dirstate")))
+        {
+            g_parent_refresh_requested = true;
+            g_parent_refresh_request_time = time_current();
         }
+        else if (string_equal(STRING_ARGS(path), STRING_ARGS(g_file_absolute_path)))
+        {
+            g_working_copy_dirty = true;
+            g_working_copy_change_time = time_current();
+        }
+    }
+}
+
+/// Returns how long until a change requested at the given time settles, or a negative delay if none is requested.
+/// Changes waiting on a request in flight are left to the completion of that request.
+static double settle_delay(bool requested, bool waiting_on_request, tick_t request_time, double delay)
+{
+    if (!requested || waiting_on_request)
+        return -1.0;
+    return generics::max(0.0, delay - time_elapsed(request_time));
+}
+
+static double refresh_revisions_delay()
+{
+    const bool fetching = g_request_fetch_revisions != 0 || g_request_refresh_revisions != 0;
+    return settle_delay(g_refresh_requested, fetching, g_refresh_request_time, REFRESH_DELAY);
+}
+
+static double refresh_parent_revision_delay()
+{
+    return settle_delay(g_parent_refresh_requested, g_request_parent_revision != 0, g_parent_refresh_request_time, REFRESH_DELAY);
+}
+
+static double refresh_working_copy_delay()
+{
+    return settle_delay(g_working_copy_dirty, false, g_working_copy_change_time, WORKING_COPY_REFRESH_DELAY);
+}
+
+/// Fetches the revisions newer than the ones already known, once the changelog stopped changing for a bit.
+static void refresh_revisions()
+{
+    if (refresh_revisions_delay() != 0.0)
+        return;
+
+    g_refresh_requested = false;
+    if (g_revisions.empty())
+    {
+        fetch_revisions();
+        return;
     }
-    
-    if (!g_revisions.empty())
+
+    // The working copy pseudo revision id is past any committed one.
+    int last_id = -1;
+    for (const auto& rev : g_revisions)
     {
-        for (size_t  i = 0; i < MAX_SINGLE_FETCH; ++i)
+        if (rev.id != wdir::REVISION_ID)
+            last_id = generics::max(last_id, rev.id);
+    }
+    g_request_refresh_revisions = scm::fetch_revisions(file_path(), working_dir(), false, last_id + 1);
+}
+
+/// Fetches the parent of the working copy again, once the dirstate stopped changing for a bit.
+static void refresh_parent_revision()
+{
+    if (refresh_parent_revision_delay() != 0.0)
+        return;
+
+    g_parent_refresh_requested = false;
+    fetch_parent_revision();
+}
+
+static void remove_working_copy_revision()
+{
+    if (!has_working_copy_revision())
+        return;
+
+    scm::revision_deallocate(g_revisions.back());
+    g_revisions.pop_back();
+    if (g_current_revision_id == wdir::REVISION_ID && !g_revisions.empty())
+        g_current_revision_id = g_revisions.back().id;
+}
+
+/// Annotates the working copy against the annotations of its parent revision held in memory, rather than running
+/// annotate again: only the lines added or modified since the parent revision get attributed to the working copy.
+static void annotate_working_copy(const scm::revision_t& parent)
+{
+    PROFILE_SCOPE("session working copy");
+    g_working_copy_parent_annotations = parent.annotations;
+
+    stream_t* stream = fs_open_file(STRING_ARGS(g_file_path), STREAM_IN | STREAM_BINARY);
+    if (!stream)
+    {
+        remove_working_copy_revision();
+        return;
+    }
+
+    const size_t size = stream_size(stream);
+    string_t text = string_allocate(0, size + 1);
+    text.length = stream_read(stream, text.str, size);
+    stream_deallocate(stream);
+
+    scm::revision_t rev;
+    rev.id = wdir::REVISION_ID;
+    rev.extra_fetched = true;
+    rev.arena = memory_arena_allocate(HASH_TIMELAPSE, 0);
+
+    pool::line_t change;
+    {
+        // The info strings live in the revision arena as well, so they get released along with the revision.
+        scoped_arena_t scope(rev.arena);
+
+        char date_buffer[32] = "";
+        const time_t modified = (time_t)(fs_last_modified(STRING_ARGS(g_file_path)) / 1000);
+        const size_t date_length = strftime(date_buffer, sizeof(date_buffer), "%Y-%m-%d %H:%M", localtime(&modified));
+
+        char username_buffer[128];
+        const string_t username = system_username(STRING_CONST(username_buffer));
+        rev.rev = string_clone(STRING_CONST("wdir()"));
+        rev.author = string_clone(STRING_ARGS(username));
+        rev.branch = string_clone(STRING_ARGS(parent.branch));
+        rev.date = string_clone(date_buffer, date_length);
+        rev.dateold = string_clone(STRING_CONST("not committed"));
+        rev.description = string_clone(STRING_CONST("Uncommitted changes"));
+        rev.time = string_to_date(STRING_ARGS(rev.date));
+
+        // Lines changed in the working copy are annotated like the annotate output of hg (i.e. short date).
+        change.author = pool::intern_string(STRING_ARGS(rev.author));
+        change.rev = pool::intern_string(STRING_ARGS(rev.rev));
+        change.date = pool::intern_string(rev.date.str, generics::min(rev.date.length, (size_t)10));
+        change.time = rev.time;
+    }
+
+    const bool changed = wdir::annotate(parent.annotations, STRING_ARGS(text), change, rev.arena, rev.annotations);
+    string_deallocate(text.str);
+    if (!changed)
+    {
+        scm::revision_deallocate(rev);
+        remove_working_copy_revision();
+        return;
+    }
+
+    // Follow the head of the revisions, unless another revision got selected.
+    const bool at_head = !g_revisions.empty() && g_current_revision_id == g_revisions.back().id;
+    if (has_working_copy_revision())
+    {
+        scm::revision_deallocate(g_revisions.back());
+        g_revisions.back() = rev;
+    }
+    else
+        g_revisions.push_back(rev);
+
+    if (at_head)
+        g_current_revision_id = rev.id;
+}
+
+/// Annotates the working copy again once the file stopped being saved for a bit, or once its parent revision changed.
+static void refresh_working_copy()
+{
+    // Without the parent annotations there is nothing to annotate against, the working copy gets annotated once they
+    // come in (see parent_changed). The file content is not part of a replayed trace.
+    scm::revision_t* parent = g_parent_revision_id >= 0 && !replay::is_replaying() ? find_revision(g_parent_revision_id) : nullptr;
+    if (!parent || !parent->extra_fetched)
+    {
+        g_working_copy_dirty = false;
+        return;
+    }
+
+    // The parent never gets compressed again, see update_working_set.
+    scm::revision_decompress(*parent);
+
+    const bool parent_changed = parent->annotations != g_working_copy_parent_annotations;
+    if (!parent_changed && (!g_working_copy_dirty || time_elapsed(g_working_copy_change_time) < WORKING_COPY_REFRESH_DELAY))
+        return;
+
+    g_working_copy_dirty = false;
+    annotate_working_copy(*parent);
+}
+
+static bool process_annotations_request(scm::request_t request)
+{
+    PROFILE_SCOPE("session annotations");
+    scm::annotations_t annotations = scm::revision_annotations(request);
+
+    bool updated = false;
+    // Failed requests (i.e. commands missing from a replayed trace) leave the revision marked as fetched, without extra data.
+    scm::revision_t* rev = find_revision(annotations.revid);
+    if (rev && array_size(annotations.lines) != 0)
+    {
+        scm::revision_set_annotations(*rev, annotations);
+        rev->extra_fetched = true;
+        updated = true;
+        g_working_set_dirty = true;
+    }
+
+    scm::annotations_finailze(annotations);
+    return updated;
+}
+
+static bool is_near_cursor(int index, int cursor)
+{
+    return cursor >= 0 && index >= cursor - WORKING_SET_PREFETCH_DISTANCE && index <= cursor + WORKING_SET_PREFETCH_DISTANCE;
+}
+
+/// Decompresses the revisions around the cursor, then compresses the revisions viewed the least recently until
+/// their extra data fits in 3/4 of the working set again. Left for the next updates once out of time.
+static void update_working_set()
+{
+    if (!g_working_set_dirty)
+        return;
+
+    PROFILE_SCOPE("session working set");
+    const tick_t start = time_current();
+    const int cursor = revision_cursor();
+    const int revision_count = (int)g_revisions.size();
+    for (int i = generics::max(0, cursor - WORKING_SET_PREFETCH_DISTANCE); cursor >= 0 && i < revision_count && is_near_cursor(i, cursor); ++i)
+    {
+        if (!g_revisions[i].cold)
+            continue;
+
+        scm::revision_decompress(g_revisions[i]);
+        if (time_elapsed(start) > WORKING_SET_TIME_BUDGET)
+            return;
+    }
+
+    // The pooled lines are shared by the resident revisions, each one is accounted for its share of them by line count.
+    size_t resident = 0;
+    size_t resident_lines = 0;
+    for (const auto& rev : g_revisions)
+    {
+        resident += memory_arena_size(rev.arena);
+        if (rev.arena)
+            resident_lines += array_size(rev.annotations);
+    }
+    const size_t pool_memory = pool::stats().memory;
+    resident += pool_memory;
+    if (resident <= g_working_set)
+    {
+        g_working_set_dirty = false;
+        return;
+    }
+
+    // The working copy and its parent are left alone, since the working copy gets annotated again from its parent.
+    generics::vector<scm::revision_t*> candidates;
+    for (int i = 0; i < revision_count; ++i)
+    {
+        scm::revision_t& rev = g_revisions[i];
+        if (rev.arena && rev.extra_fetched && !is_near_cursor(i, cursor) &&
+            rev.id != wdir::REVISION_ID && rev.id != g_parent_revision_id)
+            candidates.push_back(&rev);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const scm::revision_t* a, const scm::revision_t* b) { return a->access < b->access; });
+
+    const size_t target = g_working_set / 4 * 3;
+    for (scm::revision_t* rev : candidates)
+    {
+        const size_t pool_share = resident_lines > 0 ? pool_memory * array_size(rev->annotations) / resident_lines : 0;
+        const size_t size = memory_arena_size(rev->arena) + pool_share;
+        if (scm::revision_compress(*rev))
         {
-            if (g_request_fetch_single_revisions[i] == 0)
-            {
-                int fetch_new_revision_id = -1;
+            resident -= size;
+            g_pool_flush_requested = true;
+        }
 
-                // Make sure we have annotations data for the current revision
-                scm::revision_t* crev = current_revision();
-                if (crev && array_capacity(crev->annotations) == 0)
-                {
-                    array_reserve(crev->annotations, 1);
-                    fetch_new_revision_id = crev->id;
-                }
-                else
-                {
-                    // Otherwise fetch extra info for individual revisions
-                    for (size_t ri = g_revisions.size() - 1; ri != -1; --ri)
-                    {
-                        auto& rev = g_revisions[ri];
-                        if (array_capacity(rev.annotations) == 0)
-                        {
-                            fetch_new_revision_id = rev.id;
-                            array_reserve(rev.annotations, 1);
-                            break;
-                        }
-                    }
-                }
+        if (resident <= target)
+            break;
+        if (time_elapsed(start) > WORKING_SET_TIME_BUDGET)
+            return;
+    }
+
+    // Whatever is left over only gets compressed once other revisions got fetched or viewed.
+    g_working_set_dirty = false;
+}
+
+/// Releases the pooled lines which only compressed revisions used, the lines of the resident revisions get new ids.
+/// Lines interned by the annotation requests in flight are not referenced yet, so no other request gets scheduled
+/// until they completed (see fetch_revisions_annotations).
+static void flush_pool()
+{
+    if (!g_pool_flush_requested || is_fetching_annotations())
+        return;
 
-                if (fetch_new_revision_id != -1)
+    PROFILE_SCOPE("session pool flush");
+    generics::vector<pool::line_id_t*> arrays;
+    for (auto& rev : g_revisions)
+    {
+        if (rev.annotations)
+            arrays.push_back(rev.annotations);
+    }
+    pool::compact(arrays.begin(), arrays.size());
+
+    // Measured again, in case the lines of the resident revisions alone do not fit.
+    g_pool_flush_requested = false;
+    g_working_set_dirty = true;
+}
+
+static void fetch_revisions_annotations()
+{
+    if (g_pool_flush_requested)
+        return;
+
+    for (size_t  i = 0; i < MAX_SINGLE_FETCH; ++i)
+    {
+        if (g_request_fetch_single_revisions[i] != 0)
+            continue;
+
+        const scm::revision_t* fetch_new_revision = nullptr;
+
+        // Make sure we have annotations data for the current revision
+        scm::revision_t* crev = find_revision(g_current_revision_id);
+        if (crev && !crev->cold && array_capacity(crev->annotations) == 0)
+        {
+            array_reserve(crev->annotations, 1);
+            fetch_new_revision = crev;
+        }
+        else
+        {
+            // Otherwise fetch extra info for individual revisions
+            for (size_t ri = g_revisions.size() - 1; ri != -1; --ri)
+            {
+                auto& rev = g_revisions[ri];
+                if (!rev.cold && array_capacity(rev.annotations) == 0)
                 {
-                    g_request_fetch_single_revisions[i] = scm::fetch_revision_annotations(file_path(), working_dir(), fetch_new_revision_id);
+                    fetch_new_revision = &rev;
+                    array_reserve(rev.annotations, 1);
+                    break;
                 }
             }
-            else if (g_request_fetch_single_revisions[i] != 0 && scm::is_request_done(g_request_fetch_single_revisions[i]))
-            {
-                scm::annotations_t annotations = scm::revision_annotations(g_request_fetch_single_revisions[i]);
-                g_request_fetch_single_revisions[i] = scm::dispose_request(g_request_fetch_single_revisions[i]);
+        }
 
-                scm::revision_t* rev = find_revision(annotations.revid);
-                if (rev)
+        if (!fetch_new_revision)
+            break;
+        
+        g_request_fetch_single_revisions[i] = scm::fetch_revision_annotations(file_path(), working_dir(), fetch_new_revision->id, fetch_new_revision->rev.str);
+    }
+}
+
+void update()
+{
+    TIMING_SCOPE(session_update, "session update");
+    const tick_t update_start = time_current();
+
+    // Process completed requests pushed by the workers, up to the update time budget.
+    while (scm::request_t request = scm::pop_completed_request())
+    {
+        if (request == g_request_fetch_revisions)
+        {
+            process_revisions_request(request);
+            g_request_fetch_revisions = scm::dispose_request(request);
+
+            if (g_revisions.size() > 0)
+                set_current_revision(g_revisions.back().id);
+        }
+        else if (request == g_request_refresh_revisions)
+        {
+            process_refresh_revisions_request(request);
+            g_request_refresh_revisions = scm::dispose_request(request);
+        }
+        else if (request == g_request_parent_revision)
+        {
+            g_parent_revision_id = scm::parent_revision(request);
+            g_request_parent_revision = scm::dispose_request(request);
+            if (g_parent_revision_id < 0)
+                remove_working_copy_revision();
+        }
+        else if (request == g_request_order_revisions)
+        {
+            process_order_revisions_request(request);
+            g_request_order_revisions = scm::dispose_request(request);
+        }
+        else
+        {
+            for (size_t  i = 0; i < MAX_SINGLE_FETCH; ++i)
+            {
+                if (g_request_fetch_single_revisions[i] == request)
                 {
-                    FOUNDATION_ASSERT(array_size(annotations.lines) != 0);
-                    std::swap(rev->patch, annotations.patch);
-                    std::swap(rev->base_summary, annotations.base_summary);
-                    std::swap(rev->merged_date, annotations.date);
-                    std::swap(rev->annotations, annotations.lines);
-                    rev->extra_fetched = true;
-
-                    std::sort(g_revisions.begin(), g_revisions.end(), revision_compare);
+                    g_revisions_order_dirty |= process_annotations_request(request);
+                    g_request_fetch_single_revisions[i] = 0;
+                    break;
                 }
-
-                scm::annotations_finailze(annotations);
             }
+
+            scm::dispose_request(request);
         }
+
+        if (time_elapsed(update_start) > COMPLETED_REQUESTS_TIME_BUDGET)
+            break;
+    }
+
+    process_file_events();
+    refresh_revisions();
+    refresh_parent_revision();
+    refresh_working_copy();
+
+    // Merged dates changed or new revisions got appended, sort the revisions again in a worker thread.
+    order_revisions();
+    update_working_set();
+    flush_pool();
+
+    if (!g_revisions.empty() && g_fetch_annotations)
+        fetch_revisions_annotations();
+}
+
+bool has_pending_updates()
+{
+    return scm::has_completed_requests() || g_working_set_dirty ||
+        refresh_revisions_delay() == 0.0 || refresh_parent_revision_delay() == 0.0 || refresh_working_copy_delay() == 0.0;
+}
+
+double next_update_delay()
+{
+    const double settle_delays[] = { refresh_revisions_delay(), refresh_parent_revision_delay(), refresh_working_copy_delay() };
+    double delay = -1.0;
+    for (const double settle : settle_delays)
+    {
+        if (settle >= 0.0 && (delay < 0.0 || settle < delay))
+            delay = settle;
     }
+    return delay;
 }
 
 const generics::vector<scm::revision_t>& revisions()
@@ -198,7 +823,7 @@ bool is_fetching_annotations()
 {
     for (size_t i = 0; i < MAX_SINGLE_FETCH; ++i)
     {
-        if (!scm::is_request_done(g_request_fetch_single_revisions[i]))
+        if (g_request_fetch_single_revisions[i] != 0)
             return true;
     }
     return false;
@@ -251,6 +876,11 @@ int set_current_revision(int id)
     {
         if (rev.id == id)
         {
+            if (g_current_revision_id != id)
+            {
+                rev.access = ++g_access_clock;
+                g_working_set_dirty = true;
+            }
             g_current_revision_id = id;
             return id;
         }
@@ -261,11 +891,45 @@ int set_current_revision(int id)
 
 scm::revision_t* current_revision()
 {
-    return find_revision(g_current_revision_id);
+    // Usually decompressed ahead by update_working_set, unless jumping far from the previous revision.
+    scm::revision_t* crev = find_revision(g_current_revision_id);
+    if (crev)
+        scm::revision_decompress(*crev);
+    return crev;
+}
+
+void set_working_set(size_t size)
+{
+    g_working_set = size;
+    g_working_set_dirty = true;
+}
+
+working_set_stats_t working_set_stats()
+{
+    working_set_stats_t stats;
+    for (const auto& rev : g_revisions)
+    {
+        if (rev.arena)
+        {
+            stats.resident_revisions++;
+            stats.resident += memory_arena_size(rev.arena);
+        }
+        else if (rev.cold)
+        {
+            stats.compressed_revisions++;
+            stats.compressed += scm::revision_compressed_size(rev);
+        }
+    }
+    stats.pool = pool::stats().memory;
+    stats.working_set = g_working_set;
+    return stats;
 }
 
 bool is_valid()
 {
+    // The file of a replayed session may not even exist on this machine, the trace has all the scm outputs.
+    if (replay::is_replaying())
+        return g_file_path.length > 0;
     return fs_is_file(STRING_ARGS(g_file_path));
 }
 
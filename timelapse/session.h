@@ -11,6 +11,13 @@ namespace session {
     /// Periodically update the current session data (check scm requests, compile data, etc.)
     void update();
 
+    /// Are there completed scm requests or settled changes left to be processed by the next update?
+    bool has_pending_updates();
+
+    /// Returns how long until a change waiting to settle (i.e. the changelog being written) is due for an update,
+    /// or a negative delay if none is waiting. Lets the caller sleep until then rather than update every frame.
+    double next_update_delay();
+
     /// Cleanup any resources used by the current user session
     void shutdown();
 
@@ -26,6 +33,11 @@ namespace session {
     /// Fetch current file revisions in another thread
     bool fetch_revisions();
 
+    /// Takes over a sorted revision list and the arena holding their info strings (see scm::request_revisions),
+    /// replacing the current revisions. Revisions which do not come from a fetch request (i.e. benchmarks) are
+    /// loaded without fetch_annotations, in which case the annotations of the revisions never get fetched.
+    void load_revisions(generics::vector<scm::revision_t>& revisions, memory_arena_t* arena, bool fetch_annotations = true);
+
     /// Are the current file revision fetched?
     bool is_fetching_revisions();
 
@@ -44,9 +56,27 @@ namespace session {
     /// Sets the current revision being watched by id (if any)
     int set_current_revision(int id);
 
-    /// Returns the current revision (if any, otherwise nullptr is returned)
+    /// Returns the current revision (if any, otherwise nullptr is returned), decompressing its extra data if needed.
     scm::revision_t* current_revision();
 
+    /// Sets how much memory the extra data of the revisions (patches, annotations and their pooled lines) may use,
+    /// past which the revisions viewed the least recently get compressed until viewed again.
+    void set_working_set(size_t size);
+
+    struct working_set_stats_t
+    {
+        size_t working_set{};
+        size_t resident{};
+        size_t resident_revisions{};
+        /// Lines of the resident revisions, in the line pool (see pool.h).
+        size_t pool{};
+        size_t compressed{};
+        size_t compressed_revisions{};
+    };
+
+    /// Snapshot of the revision memory, used by the diagnostics overlay.
+    working_set_stats_t working_set_stats();
+
     /// Returns the revision sets of the current file being watched.
     const generics::vector<scm::revision_t>& revisions();
 
@@ -0,0 +1,199 @@
+#include "common.h"
+
+#include "foundation/foundation.h"
+#include "foundation/hashstrings.h"
+#include "foundation/string.h"
+#include "foundation/log.h"
+
+#define TESTS_ARRAYSIZE(_ARR) ((size_t)(sizeof(_ARR)/sizeof(*(_ARR))))
+
+// Inputs of the split checks, sized around the vector widths of the character scan (16, 32 and 64 bytes).
+const size_t SPLIT_CHECK_LENGTHS[] = { 0, 1, 2, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129 };
+const size_t SPLIT_CHECK_MAX_FIELDS = 256;
+
+static bool check_same_slices(const char* label, const char* str, size_t len, const string_const_t* expected, size_t expected_count,
+    const string_const_t* actual, size_t actual_count)
+{
+    bool same = expected_count == actual_count;
+    for (size_t i = 0; same && i < actual_count; ++i)
+        same = expected[i].str == actual[i].str && expected[i].length == actual[i].length;
+    if (!same)
+    {
+        log_errorf(HASH_TEST, ERROR_INTERNAL_FAILURE, STRING_CONST("%s differs from string_explode (%" PRIsize " vs %" PRIsize " slices) on \"%.*s\""),
+            label, actual_count, expected_count, (int)len, str);
+    }
+    return same;
+}
+
+/// Compares the vectorized splits (and string_find_all) with string_explode and a scalar scan on the same input.
+static bool check_split(const char* str, size_t len)
+{
+    string_const_t expected[SPLIT_CHECK_MAX_FIELDS];
+    bool passed = true;
+
+    size_t expected_count = string_explode(str, len, STRING_CONST(STRING_NEWLINE), expected, SPLIT_CHECK_MAX_FIELDS, false);
+    lines_t lines = string_split_lines(str, len);
+    passed &= check_same_slices("string_split_lines", str, len, expected, expected_count, lines.items, lines.count);
+    string_lines_finalize(lines);
+
+    for (int empty = 0; empty < 2; ++empty)
+    {
+        const bool allow_empty = empty != 0;
+        string_const_t fields[SPLIT_CHECK_MAX_FIELDS];
+        expected_count = string_explode(str, len, STRING_CONST("|"), expected, SPLIT_CHECK_MAX_FIELDS, allow_empty);
+        const size_t field_count = string_split_fields(str, len, '|', fields, SPLIT_CHECK_MAX_FIELDS, allow_empty);
+        passed &= check_same_slices(allow_empty ? "string_split_fields (empty fields)" : "string_split_fields",
+            str, len, expected, expected_count, fields, field_count);
+    }
+
+    generics::vector<size_t> offsets;
+    string_find_all(str, len, '\n', offsets);
+    size_t match_count = 0;
+    for (size_t i = 0; i < len && passed; ++i)
+    {
+        if (str[i] != '\n')
+            continue;
+        passed = match_count < offsets.size() && offsets[match_count] == i;
+        match_count++;
+    }
+    if (!passed || match_count != offsets.size())
+    {
+        log_errorf(HASH_TEST, ERROR_INTERNAL_FAILURE, STRING_CONST("string_find_all differs from a scalar scan on \"%.*s\""), (int)len, str);
+        passed = false;
+    }
+
+    return passed;
+}
+
+/// Checks the vectorized line and field splitting on repeated patterns of every length around the vector widths.
+/// Each input is checked at a few misalignments, since the scan handles the unaligned head and the tail separately.
+static bool run_split_checks()
+{
+    static const char* patterns[] = {
+        "a",            // no delimiter at all
+        "ab\n",         // lines
+        "ab|cd|",       // fields
+        "||\n\n",       // consecutive delimiters
+        "ab\r\n",       // CRLF lines
+        "\n",           // delimiters only
+    };
+
+    char buffer[256 + 8];
+    size_t check_count = 0, failure_count = 0;
+    for (const char* pattern : patterns)
+    {
+        const size_t pattern_length = strlen(pattern);
+        for (size_t len : SPLIT_CHECK_LENGTHS)
+        {
+            for (size_t offset = 0; offset < 4; ++offset)
+            {
+                char* str = buffer + offset;
+                for (size_t i = 0; i < len; ++i)
+                    str[i] = pattern[i % pattern_length];
+                str[len] = '\0';
+
+                // Trailing and leading delimiters on the same input, and without any trailing newline.
+                for (int variant = 0; variant < 3; ++variant)
+                {
+                    if (variant == 1 && len > 0)
+                        str[len - 1] = '\n';
+                    else if (variant == 2 && len > 0)
+                        str[0] = '|', str[len - 1] = 'z';
+                    check_count++;
+                    failure_count += check_split(str, len) ? 0 : 1;
+                }
+            }
+        }
+    }
+
+    log_infof(HASH_TEST, STRING_CONST("Split checks: %" PRIsize " inputs, %" PRIsize " failures"), check_count, failure_count);
+    return failure_count == 0;
+}
+
+struct split_case_t
+{
+    const char* label;
+    const char* str;
+    size_t line_count;
+    const char* last_line;
+};
+
+/// Inputs the scan is the most likely to get wrong, checked against string_explode and against the lines expected.
+static bool run_split_edge_cases()
+{
+    static const split_case_t cases[] = {
+        { "empty input", "", 0, nullptr },
+        { "no trailing newline", "first\nsecond\nlast", 3, "last" },
+        { "trailing newline", "first\nsecond\n", 2, "second" },
+        { "CRLF lines keep their \\r", "first\r\nsecond\r\n", 2, "second\r" },
+        { "empty lines", "\n\nfirst\n\n\nlast", 2, "last" },
+    };
+
+    size_t failure_count = 0;
+    for (const split_case_t& split_case : cases)
+    {
+        const size_t len = strlen(split_case.str);
+        bool passed = check_split(split_case.str, len);
+
+        lines_t lines = string_split_lines(split_case.str, len);
+        passed &= lines.count == split_case.line_count;
+        if (passed && split_case.last_line)
+            passed = string_equal(STRING_ARGS(lines.items[lines.count - 1]), split_case.last_line, strlen(split_case.last_line));
+        string_lines_finalize(lines);
+
+        if (!passed)
+        {
+            log_errorf(HASH_TEST, ERROR_INTERNAL_FAILURE, STRING_CONST("Split edge case failed: %s"), split_case.label);
+            failure_count++;
+        }
+    }
+
+    // Empty input also comes as a null string.
+    failure_count += check_split(nullptr, 0) ? 0 : 1;
+
+    // A single separator on either side of each vector block boundary (16, 32 and 64 bytes), and at the end.
+    static const size_t boundaries[] = { 15, 16, 31, 32, 47, 48, 63, 64, 127, 128, 129 };
+    static const char separators[] = { '\n', '|' };
+    char buffer[130 + 1];
+    const size_t len = sizeof(buffer) - 1;
+    for (const char separator : separators)
+    {
+        for (const size_t boundary : boundaries)
+        {
+            memset(buffer, 'x', len);
+            buffer[len] = '\0';
+            buffer[boundary] = separator;
+            failure_count += check_split(buffer, len) ? 0 : 1;
+        }
+    }
+
+    log_infof(HASH_TEST, STRING_CONST("Split edge cases: %" PRIsize " inputs, %" PRIsize " failures"),
+        TESTS_ARRAYSIZE(cases) + 1 + TESTS_ARRAYSIZE(separators) * TESTS_ARRAYSIZE(boundaries), failure_count);
+    return failure_count == 0;
+}
+
+extern int main_initialize()
+{
+    application_t application;
+    foundation_config_t config;
+    memset(&config, 0, sizeof config);
+    memset(&application, 0, sizeof application);
+
+    application.name = string_const(STRING_CONST("tests"));
+    application.short_name = string_const(STRING_CONST("tests"));
+    application.flags = APPLICATION_UTILITY;
+
+    return foundation_initialize(memory_system_malloc(), application, config);
+}
+
+extern int main_run(void*)
+{
+    bool passed = run_split_edge_cases();
+    passed &= run_split_checks();
+    return passed ? 0 : 1;
+}
+
+extern void main_finalize()
+{
+    foundation_finalize();
+}
@@ -0,0 +1,136 @@
+#include "timing.h"
+
+#include "foundation/string.h"
+#include "foundation/hashstrings.h"
+#include "foundation/fs.h"
+#include "foundation/log.h"
+#include "foundation/ringbuffer.h"
+
+#define HASH_TIMELAPSE (static_hash_string("timelapse", 9, 1468255696394573417ULL))
+
+namespace timelapse { namespace timing {
+
+const int SECTION_COUNT = (int)section_t::count;
+
+// Profile history kept for hitch captures, holding up to 64K blocks (a few seconds)
+const size_t HITCH_HISTORY_SIZE = 4 * 1024 * 1024 + 1;
+const deltatime_t HITCH_WINDOW_BEFORE = 2.0;
+const deltatime_t HITCH_WINDOW_AFTER = 1.0;
+
+static ringbuffer_t* g_hitch_history = nullptr;
+static deltatime_t g_hitch_budget = 0;
+static char g_hitch_directory[BUILD_MAX_PATHLEN] = {};
+static size_t g_hitch_directory_length = 0;
+
+static tick_t g_frame_start = 0;
+static tick_t g_section_ticks[SECTION_COUNT] = {};
+
+// Times in milliseconds of the last frames, g_history_offset being the oldest entry
+static float g_frame_times[FRAME_HISTORY_COUNT] = {};
+static float g_section_times[SECTION_COUNT][FRAME_HISTORY_COUNT] = {};
+static int g_history_offset = 0;
+static int g_history_count = 0;
+
+static float ticks_to_ms(tick_t ticks)
+{
+    return (float)(time_ticks_to_seconds(ticks) * 1000.0);
+}
+
+static void capture_hitch(tick_t frame_start, deltatime_t frame_time)
+{
+    const tick_t ticks_per_second = time_ticks_per_second();
+    const tick_t from = frame_start - (tick_t)(HITCH_WINDOW_BEFORE * ticks_per_second);
+    const tick_t to = time_current() + (tick_t)(HITCH_WINDOW_AFTER * ticks_per_second);
+
+    char path_buffer[BUILD_MAX_PATHLEN];
+    string_t path = string_format(STRING_CONST(path_buffer), STRING_CONST("%.*s/hitch-%" PRIu64 ".json"),
+        (int)g_hitch_directory_length, g_hitch_directory, time_system());
+    if (profile_capture_trace(STRING_ARGS(path), from, to))
+    {
+        log_infof(HASH_TIMELAPSE, STRING_CONST("Frame took %.1f ms (budget is %.1f ms), capturing profile trace to %.*s"),
+            frame_time * 1000.0, g_hitch_budget * 1000.0, STRING_FORMAT(path));
+    }
+}
+
+bool start_hitch_capture(const char* directory, size_t length, deltatime_t budget)
+{
+    if (g_hitch_history || length >= sizeof(g_hitch_directory))
+        return false;
+
+    fs_make_directory(directory, length);
+    g_hitch_directory_length = string_copy(STRING_CONST(g_hitch_directory), directory, length).length;
+    g_hitch_budget = budget;
+    g_hitch_history = ringbuffer_allocate(HITCH_HISTORY_SIZE);
+    profile_set_output_history(g_hitch_history);
+    return true;
+}
+
+void stop_hitch_capture()
+{
+    if (!g_hitch_history)
+        return;
+
+    ringbuffer_deallocate(g_hitch_history);
+    g_hitch_history = nullptr;
+}
+
+void begin_frame()
+{
+    g_frame_start = time_current();
+    for (int i = 0; i < SECTION_COUNT; ++i)
+        g_section_ticks[i] = 0;
+}
+
+void end_frame()
+{
+    if (g_frame_start == 0)
+        return;
+
+    const deltatime_t frame_time = time_elapsed(g_frame_start);
+    if (g_hitch_history && frame_time > g_hitch_budget)
+        capture_hitch(g_frame_start, frame_time);
+
+    g_frame_times[g_history_offset] = (float)(frame_time * 1000.0);
+    for (int i = 0; i < SECTION_COUNT; ++i)
+        g_section_times[i][g_history_offset] = ticks_to_ms(g_section_ticks[i]);
+
+    g_history_offset = (g_history_offset + 1) % FRAME_HISTORY_COUNT;
+    if (g_history_count < FRAME_HISTORY_COUNT)
+        g_history_count++;
+    g_frame_start = 0;
+}
+
+void add_section_time(section_t section, tick_t elapsed)
+{
+    FOUNDATION_ASSERT(section < section_t::count);
+    g_section_ticks[(int)section] += elapsed;
+}
+
+tick_t section_time(section_t section)
+{
+    FOUNDATION_ASSERT(section < section_t::count);
+    return g_section_ticks[(int)section];
+}
+
+const float* frame_times()
+{
+    return g_frame_times;
+}
+
+const float* section_times(section_t section)
+{
+    FOUNDATION_ASSERT(section < section_t::count);
+    return g_section_times[(int)section];
+}
+
+int history_offset()
+{
+    return g_history_offset;
+}
+
+int history_count()
+{
+    return g_history_count;
+}
+
+}}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common.h"
+
+#include "foundation/time.h"
+
+namespace timelapse { namespace timing {
+
+    /// Frame sections timed each frame, shown by the diagnostics overlay.
+    enum class section_t : unsigned char
+    {
+        session_update,
+        render_main_menu,
+        render_change_list,
+        render_revision_controls,
+        render_patch_view,
+        render_annotations_view,
+        gl_submit,
+
+        count
+    };
+
+    /// Number of frames kept in the time history.
+    const int FRAME_HISTORY_COUNT = 120;
+
+    /// Starts timing a new frame, once the main loop is done waiting for events.
+    void begin_frame();
+
+    /// Records the time spent in the frame, before the buffers get swapped.
+    void end_frame();
+
+    /// Accumulates time spent in a section for the current frame. Must be called from the main thread.
+    void add_section_time(section_t section, tick_t elapsed);
+
+    /// Returns the time spent in a section so far in the current frame.
+    tick_t section_time(section_t section);
+
+    /// Times in milliseconds of the last frames, as a ring of FRAME_HISTORY_COUNT entries in which history_offset
+    /// is the oldest entry, and of each section of these frames.
+    const float* frame_times();
+    const float* section_times(section_t section);
+    int history_offset();
+
+    /// Number of frames recorded in the history so far, up to FRAME_HISTORY_COUNT.
+    int history_count();
+
+    /// Keeps the last few seconds of profile blocks in memory and writes a trace of the frames
+    /// around any frame taking longer than the budget to the given directory. Profiling must be
+    /// initialized, but not enabled yet.
+    bool start_hitch_capture(const char* directory, size_t length, deltatime_t budget);
+
+    /// Releases the profile history, must be called once profiling has been finalized.
+    void stop_hitch_capture();
+
+    /// Times the rest of the scope as a frame section and profiles it as a named block.
+    struct scoped_section_t
+    {
+        scoped_section_t(section_t section, const char* name, size_t length)
+            : section(section), start(time_current())
+        {
+            profile_begin_block(name, length);
+        }
+
+        ~scoped_section_t()
+        {
+            profile_end_block();
+            add_section_time(section, time_elapsed_ticks(start));
+        }
+
+        scoped_section_t(const scoped_section_t&) = delete;
+        scoped_section_t& operator=(const scoped_section_t&) = delete;
+
+        section_t section;
+        tick_t start;
+    };
+
+}}
+
+#define TIMING_SCOPE(section, name) timelapse::timing::scoped_section_t \
+    FOUNDATION_PREPROCESSOR_JOIN(timing_section_, __LINE__)(timelapse::timing::section_t::section, STRING_CONST(name))
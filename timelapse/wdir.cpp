@@ -0,0 +1,153 @@
+#include "wdir.h"
+
+#include "foundation/string.h"
+#include "foundation/array.h"
+#include "foundation/memory.h"
+
+namespace timelapse { namespace wdir {
+
+// Past that many inserted or removed lines between two saves, the lines left in between the common
+// head and tail are all considered changed instead of being matched (i.e. file rewritten).
+const int MAX_EDIT_DISTANCE = 1024;
+
+/// Matches the lines of b to the ones of a along their shortest edit script (Myers' greedy algorithm), each
+/// step keeping the furthest reaching paths, which are walked back from the end once both sequences got reached.
+/// matches[j] gets the index of the line of a kept as the line j of b, and is left untouched otherwise.
+static bool match_lines(const pool::string_id_t* a, int n, const pool::string_id_t* b, int m, int* matches)
+{
+    const int max_distance = generics::min(n + m, MAX_EDIT_DISTANCE);
+    const int offset = max_distance + 1;
+
+    generics::vector<int> v;
+    v.resize(2 * max_distance + 3, 0);
+
+    // Furthest reaching paths of each step d, for the diagonals -d to d.
+    generics::vector<int> trace;
+    int distance = -1;
+    for (int d = 0; d <= max_distance && distance < 0; ++d)
+    {
+        for (int k = -d; k <= d; k += 2)
+        {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && a[x] == b[y])
+                ++x, ++y;
+            v[offset + k] = x;
+            if (x >= n && y >= m)
+                distance = d;
+        }
+
+        for (int k = -d; k <= d; ++k)
+            trace.push_back(v[offset + k]);
+    }
+
+    if (distance < 0)
+        return false;
+
+    int x = n, y = m;
+    for (int d = distance; d >= 0; --d)
+    {
+        const int k = x - y;
+        int start_x = 0, start_y = 0;
+        if (d > 0)
+        {
+            // Previous step paths, stored right before the ones of this step.
+            const int* previous = &trace[(size_t)(d - 1) * (d - 1)] + (d - 1);
+            const bool down = k == -d || (k != d && previous[k - 1] < previous[k + 1]);
+            const int previous_k = down ? k + 1 : k - 1;
+            const int previous_x = previous[previous_k];
+            start_x = down ? previous_x : previous_x + 1;
+            start_y = start_x - k;
+
+            while (x > start_x && y > start_y)
+                matches[--y] = --x;
+
+            x = previous_x;
+            y = previous_x - previous_k;
+        }
+        else
+        {
+            while (x > 0 && y > 0)
+                matches[--y] = --x;
+        }
+    }
+
+    return true;
+}
+
+bool annotate(const pool::line_id_t* parent, const char* text, size_t length, const pool::line_t& change,
+    memory_arena_t* arena, pool::line_id_t*& lines)
+{
+    PROFILE_SCOPE("wdir annotate");
+
+    // Unlike string_split_lines, empty lines are kept since they get annotated too. Lines are interned like
+    // the annotate output ones (i.e. without their line ending), so unchanged lines have the same code id.
+    generics::vector<pool::string_id_t> line_codes;
+    for (size_t start = 0; start < length;)
+    {
+        size_t end = string_find(text, length, '\n', start);
+        if (end == STRING_NPOS)
+            end = length;
+        const size_t line_length = end > start && text[end - 1] == '\r' ? end - start - 1 : end - start;
+        line_codes.push_back(pool::intern_string(text + start, line_length));
+        start = end + 1;
+    }
+
+    const int parent_count = (int)array_size(parent);
+    const int line_count = (int)line_codes.size();
+
+    generics::vector<pool::string_id_t> parent_codes;
+    parent_codes.resize(parent_count);
+    for (int i = 0; i < parent_count; ++i)
+        parent_codes[i] = pool::line(parent[i]).code;
+
+    // Edits are usually local, so only the lines in between the common head and tail get matched.
+    int head = 0;
+    while (head < parent_count && head < line_count && parent_codes[head] == line_codes[head])
+        ++head;
+    int tail = 0;
+    while (tail < parent_count - head && tail < line_count - head &&
+        parent_codes[parent_count - tail - 1] == line_codes[line_count - tail - 1])
+        ++tail;
+
+    if (head + tail == parent_count && parent_count == line_count)
+        return false;
+
+    generics::vector<int> matches;
+    matches.resize(line_count, -1);
+    for (int i = 0; i < head; ++i)
+        matches[i] = i;
+    for (int i = 0; i < tail; ++i)
+        matches[line_count - tail + i] = parent_count - tail + i;
+
+    if (match_lines(parent_codes.begin() + head, parent_count - head - tail, line_codes.begin() + head, line_count - head - tail, matches.begin() + head))
+    {
+        for (int i = head; i < line_count - tail; ++i)
+        {
+            if (matches[i] >= 0)
+                matches[i] += head;
+        }
+    }
+
+    // Reserved even when the file got emptied, since revisions without any capacity get annotations fetched.
+    scoped_arena_t scope(arena);
+    array_reserve(lines, line_count + 1);
+    array_resize(lines, line_count);
+    for (int i = 0; i < line_count; ++i)
+    {
+        if (matches[i] >= 0)
+        {
+            lines[i] = parent[matches[i]];
+        }
+        else
+        {
+            pool::line_t line = change;
+            line.code = line_codes[i];
+            lines[i] = pool::intern_line(line);
+        }
+    }
+
+    return true;
+}
+
+}}
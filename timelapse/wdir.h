@@ -0,0 +1,16 @@
+#pragma once
+
+#include "scm_proxy.h"
+
+namespace timelapse { namespace wdir {
+
+    /// Local revision number hg gives to the working copy (i.e. wdir()), used as the id of its pseudo revision.
+    const int REVISION_ID = 0x7fffffff;
+
+    /// Annotates the working copy text against the annotated lines of its parent revision: the unchanged lines keep
+    /// their parent annotation, while the added or modified ones get the change annotation (which code is ignored).
+    /// The line id array is allocated from the given arena. Returns false if the text has the same lines as the parent revision.
+    bool annotate(const pool::line_id_t* parent, const char* text, size_t length, const pool::line_t& change,
+        memory_arena_t* arena, pool::line_id_t*& lines);
+
+}}